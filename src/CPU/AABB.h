@@ -5,6 +5,7 @@
 
 #include "Ray.h"
 #include "Math/Vector3.h"
+#include "Math/Matrix34.h"
 
 class AABB
 {
@@ -57,6 +58,26 @@ public:
 		return AABB(small, big);
 	}
 
+	// Bounds of the transformed box (Arvo's method, no corner enumeration).
+	static AABB transformBox(const AABB& box, const Matrix34& m)
+	{
+		double small[3], big[3];
+
+		for (int i = 0; i < 3; i++)
+		{
+			small[i] = big[i] = m.m[i][3];
+			for (int j = 0; j < 3; j++)
+			{
+				double a = m.m[i][j] * box.m_min[j];
+				double b = m.m[i][j] * box.m_max[j];
+				small[i] += fmin(a, b);
+				big[i] += fmax(a, b);
+			}
+		}
+
+		return AABB(Vector3(small), Vector3(big));
+	}
+
 private:
 	Vector3 m_min, m_max;
 };
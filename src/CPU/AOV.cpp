@@ -0,0 +1,106 @@
+#include "AOV.h"
+
+#include <algorithm>
+
+void AOVBuffer::Accumulator::add(const AOVSample& sample)
+{
+	if (m_samples++ == 0)
+		m_material_id = sample.material_id;
+
+	m_aabb_tests += sample.traversal.aabb_tests;
+	m_primitive_tests += sample.traversal.primitive_tests;
+	m_traversal_depth = max(m_traversal_depth, sample.traversal.depth);
+
+	if (sample.material_id < 0)
+		return;
+
+	m_albedo += sample.albedo;
+	m_normal += sample.normal;
+	m_depth += sample.depth;
+	m_hits++;
+}
+
+void AOVBuffer::resize(int width, int height)
+{
+	m_width = max(width, 0);
+	m_height = max(height, 0);
+	m_values.assign(static_cast<size_t>(m_width) * m_height * ChannelCount, 0.0f);
+}
+
+void AOVBuffer::setPixel(int x, int y, const Accumulator& pixel, double seconds)
+{
+	float* values = &m_values[(static_cast<size_t>(y) * m_width + x) * ChannelCount];
+
+	// Misses count as black albedo but leave normal and depth to the hits.
+	Color albedo = pixel.m_samples > 0 ? pixel.m_albedo / pixel.m_samples : Color(0, 0, 0);
+	Vector3 normal = pixel.m_hits > 0 ? pixel.m_normal.getNormalied() : Vector3(0, 0, 0);
+	double depth = pixel.m_hits > 0 ? pixel.m_depth / pixel.m_hits : infinity;
+
+	values[AlbedoR] = static_cast<float>(albedo.x);
+	values[AlbedoG] = static_cast<float>(albedo.y);
+	values[AlbedoB] = static_cast<float>(albedo.z);
+	values[NormalX] = static_cast<float>(normal.x);
+	values[NormalY] = static_cast<float>(normal.y);
+	values[NormalZ] = static_cast<float>(normal.z);
+	values[Depth] = static_cast<float>(depth);
+	values[MaterialID] = static_cast<float>(pixel.m_material_id);
+	values[SampleCount] = static_cast<float>(pixel.m_samples);
+	values[Time] = static_cast<float>(seconds);
+	values[AABBTests] = pixel.m_samples > 0 ? static_cast<float>(pixel.m_aabb_tests) / pixel.m_samples : 0.0f;
+	values[PrimitiveTests] = pixel.m_samples > 0 ? static_cast<float>(pixel.m_primitive_tests) / pixel.m_samples : 0.0f;
+	values[TraversalDepth] = static_cast<float>(pixel.m_traversal_depth);
+}
+
+void AOVBuffer::appendChannels(std::vector<ImageChannel>& channels) const
+{
+	static const char* names[ChannelCount] = {
+		"albedo.R", "albedo.G", "albedo.B",
+		"N.X", "N.Y", "N.Z",
+		"Z",
+		"materialID",
+		"samples",
+		"time",
+		"traversal.aabb",
+		"traversal.primitives",
+		"traversal.depth"
+	};
+
+	const int count = Stats::counters_enabled ? ChannelCount : AABBTests;
+	for (int c = 0; c < count; c++)
+		channels.push_back({ names[c], m_values.data() + c, ChannelCount, false });
+}
+
+Framebuffer AOVBuffer::getFalseColor(Channel channel, float max_value, float* used_max) const
+{
+	if (max_value <= 0.0f && !m_values.empty())
+	{
+		std::vector<float> values(static_cast<size_t>(m_width) * m_height);
+		for (size_t i = 0; i < values.size(); i++)
+			values[i] = m_values[i * ChannelCount + channel];
+
+		auto percentile = values.begin() + values.size() * 99 / 100;
+		std::nth_element(values.begin(), percentile, values.end());
+		max_value = *percentile;
+	}
+	if (used_max)
+		*used_max = max_value;
+
+	// blue, cyan, green, yellow, red
+	static const Color ramp[5] = {
+		Color(0, 0, 1), Color(0, 1, 1), Color(0, 1, 0), Color(1, 1, 0), Color(1, 0, 0)
+	};
+
+	Framebuffer image(m_width, m_height);
+	const float scale = max_value > 0.0f ? 4.0f / max_value : 0.0f;
+	for (int y = 0; y < m_height; y++)
+	{
+		for (int x = 0; x < m_width; x++)
+		{
+			double t = clamp(static_cast<double>(get(x, y, channel) * scale), 0.0, 4.0);
+			int i = min(static_cast<int>(t), 3);
+			double f = t - i;
+			image.setPixel(x, y, ramp[i] + f * (ramp[i + 1] - ramp[i]));
+		}
+	}
+	return image;
+}
@@ -0,0 +1,98 @@
+#ifndef AOV_H
+#define AOV_H
+
+#include <vector>
+
+#include "ImageIO.h"
+#include "Stats.h"
+
+// First-hit data of one camera sample. ray_color fills it in only when it
+// is handed one, so rendering without AOVs pays a single null check.
+struct AOVSample
+{
+	Color albedo;
+	Vector3 normal;
+	double depth = infinity;	// distance to the first hit, infinity on a miss
+	int material_id = -1;
+	Stats::Traversal traversal;	// whole path, filled in by the caller
+};
+
+// Per-pixel arbitrary output variables for denoising, compositing and
+// debugging: first-hit albedo, shading normal, depth, material ID, sample
+// count, render time and, in RT_ENABLE_STATS builds, traversal cost. Rows
+// are stored top to bottom like Framebuffer.
+class AOVBuffer
+{
+public:
+	enum Channel
+	{
+		AlbedoR, AlbedoG, AlbedoB,
+		NormalX, NormalY, NormalZ,
+		Depth,
+		MaterialID,
+		SampleCount,
+		Time,			// seconds spent on the pixel
+		AABBTests,		// per sample
+		PrimitiveTests,	// per sample
+		TraversalDepth,	// deepest stack of any sample
+		ChannelCount
+	};
+
+	// Sums the samples of one pixel.
+	class Accumulator
+	{
+	public:
+		void add(const AOVSample& sample);
+
+	private:
+		friend class AOVBuffer;
+
+		Color m_albedo;
+		Vector3 m_normal;
+		double m_depth = 0.0;
+		int m_hits = 0;
+		int m_samples = 0;
+		int m_material_id = -1;	// first sample's
+		uint64_t m_aabb_tests = 0;
+		uint64_t m_primitive_tests = 0;
+		int m_traversal_depth = 0;
+	};
+
+	AOVBuffer() = default;
+	AOVBuffer(int width, int height) { resize(width, height); }
+
+	void resize(int width, int height);
+	bool isEmpty() const { return m_values.empty(); }
+
+	int getWidth() const { return m_width; }
+	int getHeight() const { return m_height; }
+
+	// Stores the averages of the accumulated samples.
+	void setPixel(int x, int y, const Accumulator& pixel, double seconds);
+
+	float get(int x, int y, Channel channel) const
+	{
+		return m_values[(static_cast<size_t>(y) * m_width + x) * ChannelCount + channel];
+	}
+
+	Color getAlbedo(int x, int y) const { return Color(get(x, y, AlbedoR), get(x, y, AlbedoG), get(x, y, AlbedoB)); }
+	Vector3 getNormal(int x, int y) const { return Vector3(get(x, y, NormalX), get(x, y, NormalY), get(x, y, NormalZ)); }
+	double getDepth(int x, int y) const { return get(x, y, Depth); }
+
+	// Adds every AOV to an EXR channel list under its conventional name.
+	// The traversal channels are left out when counters are compiled out.
+	void appendChannels(std::vector<ImageChannel>& channels) const;
+
+	// Maps channel onto a blue-to-red heat ramp from 0 to max_value. A
+	// max_value of 0 picks the channel's 99th percentile, so a few outliers
+	// do not wash out the rest. The result is display-ready, so write it
+	// with gamma 1. Returns the maximum used in used_max.
+	Framebuffer getFalseColor(Channel channel, float max_value = 0.0f, float* used_max = nullptr) const;
+
+private:
+	int m_width = 0;
+	int m_height = 0;
+	std::vector<float> m_values;	// ChannelCount floats per pixel
+};
+
+#endif // !AOV_H
@@ -1,4 +1,6 @@
 #include "BVH.h"
+#include "SceneArena.h"
+#include "Stats.h"
 
 #include <algorithm>
 
@@ -27,8 +29,11 @@ bool boxCompareZ(const shared_ptr<Hittable> a, const shared_ptr<Hittable> b)
 	return boxCompare(a, b, 2);
 }
 
-BVHNode::BVHNode(std::vector<shared_ptr<Hittable>>& objects, size_t start, size_t end, double t0, double t1)
+BVHNode::BVHNode(std::vector<shared_ptr<Hittable>>& objects, size_t start, size_t end, double t0, double t1, SceneArena* arena)
 {
+	// Only the root call times the build; the children run inside it.
+	Stats::ScopedTimer timer(Stats::BVHBuild, start == 0 && end == objects.size());
+
 	int axis = random_int(0, 2);
 
 	auto comparator = (axis == 0) ? boxCompareX
@@ -59,8 +64,16 @@ BVHNode::BVHNode(std::vector<shared_ptr<Hittable>>& objects, size_t start, size_
 		std::sort(objects.begin() + start, objects.begin() + end, comparator);
 
 		auto mid = start + object_span / 2;
-		m_left = make_shared<BVHNode>(objects, start, mid, t0, t1);
-		m_right = make_shared<BVHNode>(objects, mid, end, t0, t1);
+		if (arena)
+		{
+			m_left = arena->make<BVHNode>(objects, start, mid, t0, t1, arena);
+			m_right = arena->make<BVHNode>(objects, mid, end, t0, t1, arena);
+		}
+		else
+		{
+			m_left = make_shared<BVHNode>(objects, start, mid, t0, t1);
+			m_right = make_shared<BVHNode>(objects, mid, end, t0, t1);
+		}
 	}
 
 	AABB boxLeft, boxRight;
@@ -72,11 +85,27 @@ BVHNode::BVHNode(std::vector<shared_ptr<Hittable>>& objects, size_t start, size_
 	m_box = AABB::surroundingBox(boxLeft, boxRight);
 }
 
+BVHNode::BVHNode(shared_ptr<Hittable> left, shared_ptr<Hittable> right, double t0, double t1)
+	: m_left(left), m_right(right)
+{
+	AABB boxLeft, boxRight;
+
+	if (!m_left->boundingBox(t0, t1, boxLeft)
+		|| !m_right->boundingBox(t0, t1, boxRight))
+		std::cerr << "No bounding box in BVHNode constructor.\n";
+
+	m_box = AABB::surroundingBox(boxLeft, boxRight);
+}
+
 bool BVHNode::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const
 {
+	RT_STAT_INC(BVHNodesVisited);
+
 	if (!m_box.hit(r, tmin, tmax))
 		return false;
 
+	RT_STAT_DEPTH_SCOPE();
+
 	bool hit_left = m_left->hit(r, tmin, tmax, rec);
 	bool hit_right = m_right->hit(r, tmin, hit_left ? rec.t : tmax, rec);
 
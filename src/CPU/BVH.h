@@ -3,16 +3,22 @@
 
 #include "Hittable.h"
 
+class SceneArena;
+
 class BVHNode : public Hittable
 {
 public:
 	BVHNode() = default;
 
-	BVHNode(HittableList& list, double t0, double t1)
-		: BVHNode(list.m_list, 0, list.m_list.size(), t0, t1)
+	// Child nodes are made in the arena when one is given.
+	BVHNode(HittableList& list, double t0, double t1, SceneArena* arena = nullptr)
+		: BVHNode(list.m_list, 0, list.m_list.size(), t0, t1, arena)
 	{}
 
-	BVHNode(std::vector<shared_ptr<Hittable>>& objects, size_t start, size_t end, double t0, double t1);
+	BVHNode(std::vector<shared_ptr<Hittable>>& objects, size_t start, size_t end, double t0, double t1, SceneArena* arena = nullptr);
+
+	// Inner node over two prebuilt subtrees.
+	BVHNode(shared_ptr<Hittable> left, shared_ptr<Hittable> right, double t0, double t1);
 
 	shared_ptr<Hittable> getLeftChild() { return m_left; }
 	shared_ptr<Hittable> getRightChild() { return m_right; }
@@ -2,6 +2,7 @@
 #define CAMERA_H
 
 #include "Math/Vector3.h"
+#include "Ray.h"
 
 class Camera
 {
@@ -1,4 +1,5 @@
 #include "ConstantMedium.h"
+#include "Stats.h"
 
 bool ConstantMedium::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const
 {
@@ -6,33 +7,31 @@ bool ConstantMedium::hit(const Ray& r, const double& tmin, const double& tmax, H
 	const bool enableDebug = false;
 	const bool debugging = enableDebug && random_double() < 0.00001;
 
-	HitRecord rec1, rec2;
+	RT_STAT_INC(PrimitiveTests);
 
-	if (!m_boundary->hit(r, -infinity, infinity, rec1))
+	double t_enter, t_exit;
+	if (!m_boundary->hitSpan(r, t_enter, t_exit))
 		return false;
 
-	if (!m_boundary->hit(r, rec1.t + 0.0001, infinity, rec1))
-		return false;
-
-	if (debugging) std::cerr << "\nt0=" << rec1.t << ", t1=" << rec2.t << '\n';
+	if (debugging) std::cerr << "\nt0=" << t_enter << ", t1=" << t_exit << '\n';
 
-	if (rec1.t < tmin) rec1.t = tmin;
-	if (rec2.t > tmax) rec2.t = tmax;
+	if (t_enter < tmin) t_enter = tmin;
+	if (t_exit > tmax) t_exit = tmax;
 
-	if (rec1.t >= rec2.t)
+	if (t_enter >= t_exit)
 		return false;
 
-	if (rec1.t < 0)
-		rec1.t = 0;
+	if (t_enter < 0)
+		t_enter = 0;
 
 	const auto ray_length = r.getDirection().getLength();
-	const auto distance_inside_boundary = (rec2.t - rec1.t) * ray_length;
+	const auto distance_inside_boundary = (t_exit - t_enter) * ray_length;
 	const auto hit_distance = m_neg_inv_density * log(random_double());
 
 	if (hit_distance > distance_inside_boundary)
 		return false;
 
-	rec.t = rec1.t + hit_distance / ray_length;
+	rec.t = t_enter + hit_distance / ray_length;
 	rec.position = r.pointAt(rec.t);
 
 	if (debugging)
@@ -44,7 +43,9 @@ bool ConstantMedium::hit(const Ray& r, const double& tmin, const double& tmax, H
 
 	rec.normal = Vector3(1, 0, 0);	// arbitrary
 	rec.front_face = true;			// also arbitrary
+	rec.uv_density = 0.0;
 	rec.mat_ptr = m_phase_function;
+	RT_STAT_INC(MediumHits);
 
 	return true;
 }
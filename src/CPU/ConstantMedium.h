@@ -6,16 +6,18 @@
 class ConstantMedium : public Hittable
 {
 public:
-	ConstantMedium(shared_ptr<Hittable> b, double d, shared_ptr<Texture> a)
+	ConstantMedium(shared_ptr<Hittable> b, double d, shared_ptr<Material> phase)
 		: m_boundary(b),
 		m_neg_inv_density(-1 / d),
-		m_phase_function(make_shared<Isotropic>(a))
+		m_phase_function(phase)
+	{}
+
+	ConstantMedium(shared_ptr<Hittable> b, double d, shared_ptr<Texture> a)
+		: ConstantMedium(b, d, make_shared<Isotropic>(a))
 	{}
 
 	ConstantMedium(shared_ptr<Hittable> b, double d, Color c)
-		: m_boundary(b),
-		m_neg_inv_density(-1 / d),
-		m_phase_function(make_shared<Isotropic>(c))
+		: ConstantMedium(b, d, make_shared<Isotropic>(c))
 	{}
 
 	virtual bool hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const override;
@@ -0,0 +1,146 @@
+#include "Denoiser.h"
+
+#include <tbb/blocked_range2d.h>
+#include <tbb/parallel_for.h>
+
+namespace
+{
+	// Guide data of one pixel, gathered once up front.
+	struct Guide
+	{
+		Vector3 albedo;
+		Vector3 normal;
+		double depth;
+		bool hit;
+	};
+
+	const double albedo_epsilon = 0.01;
+
+	inline Vector3 compress(const Vector3& c)
+	{
+		return Vector3(c.x / (1.0 + fabs(c.x)), c.y / (1.0 + fabs(c.y)), c.z / (1.0 + fabs(c.z)));
+	}
+}
+
+Framebuffer denoise(const Framebuffer& image, const AOVBuffer& aovs, const DenoiseSettings& settings)
+{
+	const int width = image.getWidth();
+	const int height = image.getHeight();
+	if (aovs.getWidth() != width || aovs.getHeight() != height)
+		return image;
+
+	const size_t count = static_cast<size_t>(width) * height;
+	const int tile = max(settings.tile_size, 8);
+
+	std::vector<Guide> guides(count);
+	std::vector<Vector3> current(count);
+	std::vector<Vector3> next(count);
+
+	// Demodulate: filter irradiance, not radiance.
+	tbb::parallel_for(tbb::blocked_range<int>(0, height), [&](const tbb::blocked_range<int>& r)
+	{
+		for (int y = r.begin(); y != r.end(); y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				size_t index = static_cast<size_t>(y) * width + x;
+				Guide& g = guides[index];
+				g.albedo = aovs.getAlbedo(x, y);
+				g.normal = aovs.getNormal(x, y);
+				g.depth = aovs.getDepth(x, y);
+				g.hit = g.depth < infinity;
+
+				Color c = image.getPixel(x, y);
+				current[index] = Vector3(
+					c.x / (g.albedo.x + albedo_epsilon),
+					c.y / (g.albedo.y + albedo_epsilon),
+					c.z / (g.albedo.z + albedo_epsilon));
+			}
+		}
+	});
+
+	static const double kernel[5] = { 1.0 / 16, 1.0 / 4, 3.0 / 8, 1.0 / 4, 1.0 / 16 };
+	const double inv_normal = 1.0 / (settings.sigma_normal * settings.sigma_normal);
+	const double inv_albedo = 1.0 / (settings.sigma_albedo * settings.sigma_albedo);
+	const double inv_depth = 1.0 / settings.sigma_depth;
+
+	double sigma_color = settings.sigma_color;
+	for (int pass = 0; pass < settings.iterations; pass++)
+	{
+		const int step = 1 << pass;
+		const double inv_color = 1.0 / (sigma_color * sigma_color);
+
+		tbb::parallel_for(tbb::blocked_range2d<int>(0, height, tile, 0, width, tile), [&](const tbb::blocked_range2d<int>& r)
+		{
+			for (int y = r.rows().begin(); y != r.rows().end(); y++)
+			{
+				for (int x = r.cols().begin(); x != r.cols().end(); x++)
+				{
+					const size_t center = static_cast<size_t>(y) * width + x;
+					const Guide& gp = guides[center];
+					const Vector3 cp = compress(current[center]);
+
+					Vector3 sum(0, 0, 0);
+					double weight_sum = 0.0;
+					for (int dy = -2; dy <= 2; dy++)
+					{
+						const int qy = y + dy * step;
+						if (qy < 0 || qy >= height)
+							continue;
+
+						for (int dx = -2; dx <= 2; dx++)
+						{
+							const int qx = x + dx * step;
+							if (qx < 0 || qx >= width)
+								continue;
+
+							const size_t index = static_cast<size_t>(qy) * width + qx;
+							const Guide& gq = guides[index];
+							if (gp.hit != gq.hit)
+								continue;
+
+							double exponent = (compress(current[index]) - cp).getSquaredLength() * inv_color;
+							if (gp.hit)
+							{
+								exponent += (gq.normal - gp.normal).getSquaredLength() * inv_normal;
+								exponent += (gq.albedo - gp.albedo).getSquaredLength() * inv_albedo;
+								exponent += fabs(gq.depth - gp.depth) / (gp.depth + 1e-4) * inv_depth;
+							}
+
+							const double w = kernel[dx + 2] * kernel[dy + 2] * exp(-exponent);
+							sum += current[index] * w;
+							weight_sum += w;
+						}
+					}
+
+					// The center tap always contributes, so weight_sum > 0.
+					next[center] = sum / weight_sum;
+				}
+			}
+		});
+
+		current.swap(next);
+		sigma_color *= 0.5;
+	}
+
+	// Remodulate
+	Framebuffer result(width, height);
+	tbb::parallel_for(tbb::blocked_range<int>(0, height), [&](const tbb::blocked_range<int>& r)
+	{
+		for (int y = r.begin(); y != r.end(); y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				size_t index = static_cast<size_t>(y) * width + x;
+				const Guide& g = guides[index];
+				const Vector3& c = current[index];
+				result.setPixel(x, y, Color(
+					c.x * (g.albedo.x + albedo_epsilon),
+					c.y * (g.albedo.y + albedo_epsilon),
+					c.z * (g.albedo.z + albedo_epsilon)));
+			}
+		}
+	});
+
+	return result;
+}
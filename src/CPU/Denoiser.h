@@ -0,0 +1,23 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include "AOV.h"
+#include "Framebuffer.h"
+
+struct DenoiseSettings
+{
+	int iterations = 5;			// filter radius doubles each pass: 2, 4, ... 2^iterations
+	double sigma_color = 0.6;	// on tonemapped irradiance, halved every pass
+	double sigma_normal = 0.2;	// on the distance between unit normals
+	double sigma_depth = 0.05;	// relative to the center depth
+	double sigma_albedo = 0.1;
+	int tile_size = 64;
+};
+
+// Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010) guided by the
+// albedo, normal and depth AOVs. Color is divided by albedo before
+// filtering and multiplied back afterwards, so texture detail survives while
+// the lighting noise is smoothed. Each pass runs over tiles in parallel.
+Framebuffer denoise(const Framebuffer& image, const AOVBuffer& aovs, const DenoiseSettings& settings = DenoiseSettings());
+
+#endif // !DENOISER_H
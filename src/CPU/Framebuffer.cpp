@@ -0,0 +1,126 @@
+#include "Framebuffer.h"
+
+#include <tbb/parallel_for.h>
+
+void Framebuffer::resize(int width, int height)
+{
+	m_width = max(width, 0);
+	m_height = max(height, 0);
+	m_pixels.assign(static_cast<size_t>(m_width) * m_height * 3, 0.0f);
+}
+
+void Framebuffer::setPixel(int x, int y, const Color& c)
+{
+	float* pixel = &m_pixels[(static_cast<size_t>(y) * m_width + x) * 3];
+	pixel[0] = c.x == c.x ? static_cast<float>(c.x) : 0.0f;
+	pixel[1] = c.y == c.y ? static_cast<float>(c.y) : 0.0f;
+	pixel[2] = c.z == c.z ? static_cast<float>(c.z) : 0.0f;
+}
+
+Color Framebuffer::getPixel(int x, int y) const
+{
+	const float* pixel = &m_pixels[(static_cast<size_t>(y) * m_width + x) * 3];
+	return Color(pixel[0], pixel[1], pixel[2]);
+}
+
+Color applyExposure(const Color& c, double stops)
+{
+	return stops == 0.0 ? c : c * pow(2.0, stops);
+}
+
+Color applyToneMap(const Color& c, ToneMapper tone_mapper)
+{
+	switch (tone_mapper)
+	{
+	case ToneMapper::Reinhard:
+		return Color(c.x / (1.0 + c.x), c.y / (1.0 + c.y), c.z / (1.0 + c.z));
+
+	case ToneMapper::ACES:
+	{
+		auto curve = [](double x)
+		{
+			return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+		};
+		return Color(curve(c.x), curve(c.y), curve(c.z));
+	}
+
+	case ToneMapper::Clamp:
+	default:
+		return c;
+	}
+}
+
+Color applyGamma(const Color& c, double gamma)
+{
+	// Negative components have no meaningful encoding; clip them first.
+	double r = fmax(c.x, 0.0);
+	double g = fmax(c.y, 0.0);
+	double b = fmax(c.z, 0.0);
+
+	if (gamma == 2.0)
+		return Color(sqrt(r), sqrt(g), sqrt(b));
+
+	const double inv_gamma = 1.0 / gamma;
+	return Color(pow(r, inv_gamma), pow(g, inv_gamma), pow(b, inv_gamma));
+}
+
+void encodeRGBA8(const Framebuffer& image, const DisplayTransform& display, unsigned char* rgba)
+{
+	const int width = image.getWidth();
+	tbb::parallel_for(tbb::blocked_range<int>(0, image.getHeight()), [&](const tbb::blocked_range<int>& r)
+	{
+		for (int y = r.begin(); y != r.end(); y++)
+		{
+			unsigned char* row = rgba + static_cast<size_t>(y) * width * 4;
+			for (int x = 0; x < width; x++)
+			{
+				Color c = image.getPixel(x, y);
+				c = applyExposure(c, display.exposure);
+				c = applyToneMap(c, display.tone_mapper);
+				c = applyGamma(c, display.gamma);
+
+				row[x * 4 + 0] = static_cast<unsigned char>(256 * clamp(c.x, 0.0, 0.999));
+				row[x * 4 + 1] = static_cast<unsigned char>(256 * clamp(c.y, 0.0, 0.999));
+				row[x * 4 + 2] = static_cast<unsigned char>(256 * clamp(c.z, 0.0, 0.999));
+				row[x * 4 + 3] = 255;
+			}
+		}
+	});
+}
+
+double computeRMSE(const Framebuffer& image, const Framebuffer& reference)
+{
+	if (image.getWidth() != reference.getWidth() || image.getHeight() != reference.getHeight())
+		return infinity;
+
+	const size_t count = static_cast<size_t>(image.getWidth()) * image.getHeight() * 3;
+	if (count == 0)
+		return 0.0;
+
+	double sum = 0.0;
+	for (size_t i = 0; i < count; i++)
+	{
+		double error = static_cast<double>(image.getData()[i]) - reference.getData()[i];
+		sum += error * error;
+	}
+	return sqrt(sum / count);
+}
+
+double computeRelMSE(const Framebuffer& image, const Framebuffer& reference)
+{
+	if (image.getWidth() != reference.getWidth() || image.getHeight() != reference.getHeight())
+		return infinity;
+
+	const size_t count = static_cast<size_t>(image.getWidth()) * image.getHeight() * 3;
+	if (count == 0)
+		return 0.0;
+
+	double sum = 0.0;
+	for (size_t i = 0; i < count; i++)
+	{
+		double value = reference.getData()[i];
+		double error = image.getData()[i] - value;
+		sum += error * error / (value * value + 0.01);
+	}
+	return sum / count;
+}
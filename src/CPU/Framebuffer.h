@@ -0,0 +1,66 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <vector>
+
+#include "Math/Vector3.h"
+
+// Linear float RGB image, rows stored top to bottom. The renderer writes
+// averaged radiance here; display conversion happens separately, so the HDR
+// values stay available for re-exposure, compositing and denoising.
+class Framebuffer
+{
+public:
+	Framebuffer() = default;
+	Framebuffer(int width, int height) { resize(width, height); }
+
+	void resize(int width, int height);
+
+	int getWidth() const { return m_width; }
+	int getHeight() const { return m_height; }
+
+	// NaN components are stored as zero.
+	void setPixel(int x, int y, const Color& c);
+	Color getPixel(int x, int y) const;
+
+	// Interleaved RGB, getWidth() * 3 floats per row.
+	float* getData() { return m_pixels.data(); }
+	const float* getData() const { return m_pixels.data(); }
+
+private:
+	int m_width = 0;
+	int m_height = 0;
+	std::vector<float> m_pixels;
+};
+
+enum class ToneMapper
+{
+	Clamp,		// no compression, values above 1 clip
+	Reinhard,	// c / (1 + c)
+	ACES		// Narkowicz's fit of the ACES filmic curve
+};
+
+// Scene-referred to display-referred conversion. The stages run in order:
+// exposure (in stops), tone mapping, then gamma encoding.
+struct DisplayTransform
+{
+	double exposure = 0.0;
+	ToneMapper tone_mapper = ToneMapper::Clamp;
+	double gamma = 2.0;
+};
+
+Color applyExposure(const Color& c, double stops);
+Color applyToneMap(const Color& c, ToneMapper tone_mapper);
+Color applyGamma(const Color& c, double gamma);
+
+// Converts the framebuffer to 8-bit RGBA through the display transform.
+void encodeRGBA8(const Framebuffer& image, const DisplayTransform& display, unsigned char* rgba);
+
+// Errors against a reference image, averaged over pixels and channels.
+// relMSE divides each squared error by reference^2 + 0.01, which weighs
+// errors relative to brightness and keeps black pixels finite. Both are
+// infinity if the sizes differ.
+double computeRMSE(const Framebuffer& image, const Framebuffer& reference);
+double computeRelMSE(const Framebuffer& image, const Framebuffer& reference);
+
+#endif // !FRAMEBUFFER_H
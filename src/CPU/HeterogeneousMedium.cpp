@@ -0,0 +1,58 @@
+#include "HeterogeneousMedium.h"
+#include "Stats.h"
+
+bool HeterogeneousMedium::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const
+{
+	RT_STAT_INC(PrimitiveTests);
+
+	double t_enter, t_exit;
+	if (!m_boundary->hitSpan(r, t_enter, t_exit))
+		return false;
+
+	t_enter = fmax(fmax(t_enter, tmin), 0.0);
+	t_exit = fmin(t_exit, tmax);
+	if (t_enter >= t_exit)
+		return false;
+
+	// Delta tracking per majorant cell. The exponential is memoryless, so
+	// restarting the flight at each cell boundary keeps it unbiased.
+	double t_hit = 0.0;
+	bool scattered = m_majorants.traverse(r, t_enter, t_exit, [&](double t0, double t1, double majorant)
+	{
+		const double sigma_max = majorant * m_scale;
+		if (sigma_max <= 0.0)
+			return false;
+
+		double t = t0;
+		while (true)
+		{
+			t -= log(1.0 - random_double()) / sigma_max;
+			if (t >= t1)
+				return false;
+
+			if (random_double() * sigma_max < m_density->density(r.pointAt(t)) * m_scale)
+			{
+				t_hit = t;
+				return true;
+			}
+		}
+	});
+
+	if (!scattered)
+		return false;
+
+	rec.t = t_hit;
+	rec.position = r.pointAt(rec.t);
+	rec.normal = Vector3(1, 0, 0);	// arbitrary
+	rec.front_face = true;			// also arbitrary
+	rec.uv_density = 0.0;
+	rec.mat_ptr = m_phase_function;
+	RT_STAT_INC(MediumHits);
+
+	return true;
+}
+
+bool HeterogeneousMedium::boundingBox(const double t0, const double t1, AABB& outputBox) const
+{
+	return m_boundary->boundingBox(t0, t1, outputBox);
+}
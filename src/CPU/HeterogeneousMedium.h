@@ -0,0 +1,44 @@
+#ifndef HETEROGENEOUS_MEDIUM_H
+#define HETEROGENEOUS_MEDIUM_H
+
+#include "Material.h"
+#include "Volume.h"
+
+// Participating medium with spatially varying density, clipped to a closed
+// boundary. Free-flight distances come from delta tracking against the
+// per-cell majorants of a coarse MajorantGrid, so the estimate is unbiased
+// and cells with no density are skipped without sampling.
+class HeterogeneousMedium : public Hittable
+{
+public:
+	HeterogeneousMedium(shared_ptr<Hittable> b, shared_ptr<const DensitySource> density, double scale,
+		shared_ptr<Material> phase, int majorant_resolution = 16)
+		: m_boundary(b),
+		m_density(density),
+		m_scale(scale),
+		m_majorants(*density, majorant_resolution),
+		m_phase_function(phase)
+	{}
+
+	HeterogeneousMedium(shared_ptr<Hittable> b, shared_ptr<const DensitySource> density, double scale,
+		shared_ptr<Texture> a, int majorant_resolution = 16)
+		: HeterogeneousMedium(b, density, scale, make_shared<Isotropic>(a), majorant_resolution)
+	{}
+
+	HeterogeneousMedium(shared_ptr<Hittable> b, shared_ptr<const DensitySource> density, double scale,
+		Color c, int majorant_resolution = 16)
+		: HeterogeneousMedium(b, density, scale, make_shared<SolidColor>(c), majorant_resolution)
+	{}
+
+	virtual bool hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const override;
+	virtual bool boundingBox(const double t0, const double t1, AABB& outputBox) const override;
+
+public:
+	shared_ptr<Hittable> m_boundary;
+	shared_ptr<const DensitySource> m_density;
+	double m_scale;
+	MajorantGrid m_majorants;
+	shared_ptr<Material> m_phase_function;
+};
+
+#endif // !HETEROGENEOUS_MEDIUM_H
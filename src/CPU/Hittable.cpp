@@ -1,100 +1,104 @@
 #include "Hittable.h"
+#include "Stats.h"
 
-bool Translate::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const
+#include <stdexcept>
+
+bool Hittable::hitSpan(const Ray& r, double& t_enter, double& t_exit) const
 {
-	Ray moved_r(r.getOrigin() - m_offset, r.getDirection(), r.getTime());
-	if (!m_ptr->hit(moved_r, tmin, tmax, rec))
+	HitRecord rec1, rec2;
+
+	if (!hit(r, -infinity, infinity, rec1))
 		return false;
 
-	rec.position += m_offset;
-	rec.setFaceNormal(moved_r, rec.normal);
+	if (!hit(r, rec1.t + 0.0001, infinity, rec2))
+		return false;
 
+	t_enter = rec1.t;
+	t_exit = rec2.t;
 	return true;
 }
 
-bool Translate::boundingBox(const double t0, const double t1, AABB& outputBox) const
+Placement::Placement(const Matrix34& to_world)
+	: to_world(to_world)
 {
-	if (!m_ptr->boundingBox(t0, t1, outputBox))
-		return false;
+	if (to_world.isSingular())
+		throw std::invalid_argument("Error: Placement matrix is singular!");
 
-	outputBox = AABB(
-		outputBox.getMin() + m_offset,
-		outputBox.getMax() + m_offset
-	);
+	to_object = to_world.getInverse();
 
-	return true;
+	const auto& inv = to_object.m;
+	normal_matrix = Matrix34(
+		inv[0][0], inv[1][0], inv[2][0], 0,
+		inv[0][1], inv[1][1], inv[2][1], 0,
+		inv[0][2], inv[1][2], inv[2][2], 0);
 }
 
-RotateY::RotateY(shared_ptr<Hittable> p, double angle)
-	: m_ptr(p)
+Ray Placement::toObject(const Ray& r, double& scale) const
 {
-	auto radians = degreeToRadian(angle);
-	m_sin_theta = sin(radians);
-	m_cos_theta = cos(radians);
-	m_hasbox = m_ptr->boundingBox(0, 1, m_bbox);
+	Vector3 direction = to_object.transformVector(r.getDirection());
+	scale = direction.getLength();
+	return Ray(to_object.transformPoint(r.getOrigin()), direction, r.getTime());
+}
 
-	Point3 min( infinity,  infinity,  infinity);
-	Point3 max(-infinity, -infinity, -infinity);
+void Placement::toWorld(HitRecord& rec, double scale) const
+{
+	// The normal already faces against the ray; a linear map with its
+	// inverse transpose keeps that, so front_face stays valid.
+	rec.t /= scale;
+	rec.uv_density *= scale;
+	rec.position = to_world.transformPoint(rec.position);
+	rec.normal = normal_matrix.transformVector(rec.normal).getNormalied();
+}
 
-	for (int i = 0; i < 2; i++)
+Transform::Transform(shared_ptr<Hittable> p, const Matrix34& to_world)
+	: m_ptr(p)
+{
+	Matrix34 matrix = to_world;
+
+	// Fold a directly nested transform into this one. Determinants multiply,
+	// so two valid transforms can fold into a singular one; reject that here
+	// rather than let the object disappear.
+	if (auto inner = std::dynamic_pointer_cast<Transform>(m_ptr))
 	{
-		for (int j = 0; j < 2; j++)
-		{
-			for (int k = 0; k < 2; k++)
-			{
-				double x = i * m_bbox.getMax().x + (1 - i) * m_bbox.getMin().x;
-				double y = j * m_bbox.getMax().y + (1 - j) * m_bbox.getMin().y;
-				double z = k * m_bbox.getMax().z + (1 - k) * m_bbox.getMin().z;
-
-				double newx =  m_cos_theta * x + m_sin_theta * z;
-				double newz = -m_sin_theta * x + m_cos_theta * z;
-
-				Vector3 tester(newx, y, newz);
-
-				for (int c = 0; c < 3; c++)
-				{
-					min[c] = fmin(min[c], tester[c]);
-					max[c] = fmax(max[c], tester[c]);
-				}
-			}
-		}
+		matrix = matrix * inner->m_placement.to_world;
+		if (matrix.isSingular() && !to_world.isSingular())
+			throw std::invalid_argument("Error: nested Transforms fold into a singular matrix!");
+		m_ptr = inner->m_ptr;
 	}
 
-	m_bbox = AABB(min, max);
+	m_placement = Placement(matrix);
+
+	m_hasbox = m_ptr->boundingBox(0, 1, m_bbox);
+	if (m_hasbox)
+		m_bbox = AABB::transformBox(m_bbox, matrix);
 }
 
-bool RotateY::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const
+bool Transform::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const
 {
-	auto origin = r.getOrigin();
-	auto direction = r.getDirection();
-
-	origin[0] = m_cos_theta * r.getOrigin()[0] - m_sin_theta * r.getOrigin()[2];
-	origin[2] = m_sin_theta * r.getOrigin()[0] + m_cos_theta * r.getOrigin()[2];
-
-	direction[0] = m_cos_theta * r.getDirection()[0] - m_sin_theta * r.getDirection()[2];
-	direction[2] = m_sin_theta * r.getDirection()[0] + m_cos_theta * r.getDirection()[2];
+	double scale;
+	Ray object_r = m_placement.toObject(r, scale);
 
-	Ray rotated_r(origin, direction, r.getTime());
-
-	if (!m_ptr->hit(rotated_r, tmin, tmax, rec))
+	if (!m_ptr->hit(object_r, tmin * scale, tmax * scale, rec))
 		return false;
 
-	auto p = rec.position;
-	auto normal = rec.normal;
-
-	p[0] =  m_cos_theta * rec.position[0] + m_sin_theta * rec.position[2];
-	p[2] = -m_sin_theta * rec.position[0] + m_cos_theta * rec.position[2];
+	m_placement.toWorld(rec, scale);
+	return true;
+}
 
-	normal[0] =  m_cos_theta * rec.normal[0] + m_sin_theta * rec.normal[2];
-	normal[2] = -m_sin_theta * rec.normal[0] + m_cos_theta * rec.normal[2];
+bool Transform::hitSpan(const Ray& r, double& t_enter, double& t_exit) const
+{
+	double scale;
+	Ray object_r = m_placement.toObject(r, scale);
 
-	rec.position = p;
-	rec.setFaceNormal(rotated_r, normal);
+	if (!m_ptr->hitSpan(object_r, t_enter, t_exit))
+		return false;
 
+	t_enter /= scale;
+	t_exit /= scale;
 	return true;
 }
 
-bool RotateY::boundingBox(const double t0, const double t1, AABB& outputBox) const
+bool Transform::boundingBox(const double t0, const double t1, AABB& outputBox) const
 {
 	outputBox = m_bbox;
 	return m_hasbox;
@@ -102,6 +106,8 @@ bool RotateY::boundingBox(const double t0, const double t1, AABB& outputBox) con
 
 bool Sphere::hit(const Ray &r, const double &tmin, const double &tmax, HitRecord &rec) const
 {
+	RT_STAT_INC(PrimitiveTests);
+
 	Vector3 oc = r.getOrigin() - m_center;
 	double a = r.getDirection().getSquaredLength();
 	double half_b = oc.dotProduct(r.getDirection());
@@ -117,7 +123,9 @@ bool Sphere::hit(const Ray &r, const double &tmin, const double &tmax, HitRecord
 			Vector3 outward_normal = (rec.position - m_center) / m_radius;
 			rec.setFaceNormal(r, outward_normal);
 			Sphere::getSphereUV((rec.position - m_center) / m_radius, rec.u, rec.v);
+			rec.uv_density = 1.0 / (pi * m_radius);
 			rec.mat_ptr = m_mat_ptr;
+			RT_STAT_INC(SphereHits);
 			return true;
 		}
 
@@ -129,13 +137,31 @@ bool Sphere::hit(const Ray &r, const double &tmin, const double &tmax, HitRecord
 			Vector3 outward_normal = (rec.position - m_center) / m_radius;
 			rec.setFaceNormal(r, outward_normal);
 			Sphere::getSphereUV((rec.position - m_center) / m_radius, rec.u, rec.v);
+			rec.uv_density = 1.0 / (pi * m_radius);
 			rec.mat_ptr = m_mat_ptr;
+			RT_STAT_INC(SphereHits);
 			return true;
 		}
 	}
 	return false;
 }
 
+bool Sphere::hitSpan(const Ray& r, double& t_enter, double& t_exit) const
+{
+	Vector3 oc = r.getOrigin() - m_center;
+	double a = r.getDirection().getSquaredLength();
+	double half_b = oc.dotProduct(r.getDirection());
+	double c = oc.getSquaredLength() - m_radius * m_radius;
+	double discriminant = half_b * half_b - a * c;
+	if (discriminant <= 0.0)
+		return false;
+
+	double root = sqrt(discriminant);
+	t_enter = (-half_b - root) / a;
+	t_exit = (-half_b + root) / a;
+	return true;
+}
+
 bool Sphere::boundingBox(const double t0, const double t1, AABB& outputBox) const
 {
 	outputBox = AABB(
@@ -146,6 +172,8 @@ bool Sphere::boundingBox(const double t0, const double t1, AABB& outputBox) cons
 
 bool MovingSphere::hit(const Ray &r, const double &tmin, const double &tmax, HitRecord &rec) const
 {
+	RT_STAT_INC(PrimitiveTests);
+
 	Vector3 oc = r.getOrigin() - getCenter(r.getTime());
 	double a = r.getDirection().getSquaredLength();
 	double half_b = oc.dotProduct(r.getDirection());
@@ -162,7 +190,9 @@ bool MovingSphere::hit(const Ray &r, const double &tmin, const double &tmax, Hit
 			rec.position = r.pointAt(rec.t);
 			Vector3 outward_normal = (rec.position - getCenter(r.getTime())) / m_radius;
 			rec.setFaceNormal(r, outward_normal);
+			rec.uv_density = 0.0;
 			rec.mat_ptr = m_mat_ptr;
+			RT_STAT_INC(MovingSphereHits);
 			return true;
 		}
 
@@ -173,7 +203,9 @@ bool MovingSphere::hit(const Ray &r, const double &tmin, const double &tmax, Hit
 			rec.position = r.pointAt(rec.t);
 			Vector3 outward_normal = (rec.position - getCenter(r.getTime())) / m_radius;
 			rec.setFaceNormal(r, outward_normal);
+			rec.uv_density = 0.0;
 			rec.mat_ptr = m_mat_ptr;
+			RT_STAT_INC(MovingSphereHits);
 			return true;
 		}
 	}
@@ -201,6 +233,8 @@ Point3 MovingSphere::getCenter(double time) const
 
 bool XYRect::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const
 {
+	RT_STAT_INC(PrimitiveTests);
+
 	double t = (m_k - r.getOrigin().z) / r.getDirection().z;
 	if (t < tmin || t > tmax)
 		return false;
@@ -212,11 +246,13 @@ bool XYRect::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord
 
 	rec.u = (x - m_x0) / (m_x1 - m_x0);
 	rec.v = (y - m_y0) / (m_y1 - m_y0);
+	rec.uv_density = 1.0 / fmin(m_x1 - m_x0, m_y1 - m_y0);
 	rec.t = t;
 	Vector3 outward_normal = Vector3(0, 0, 1);
 	rec.setFaceNormal(r, outward_normal);
 	rec.mat_ptr = m_mat_ptr;
 	rec.position = r.pointAt(t);
+	RT_STAT_INC(RectHits);
 
 	return true;
 }
@@ -229,6 +265,8 @@ bool XYRect::boundingBox(const double t0, const double t1, AABB& outputBox) cons
 
 bool XZRect::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const
 {
+	RT_STAT_INC(PrimitiveTests);
+
 	double t = (m_k - r.getOrigin().y) / r.getDirection().y;
 	if (t < tmin || t > tmax)
 		return false;
@@ -240,11 +278,13 @@ bool XZRect::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord
 
 	rec.u = (x - m_x0) / (m_x1 - m_x0);
 	rec.v = (z - m_z0) / (m_z1 - m_z0);
+	rec.uv_density = 1.0 / fmin(m_x1 - m_x0, m_z1 - m_z0);
 	rec.t = t;
 	Vector3 outward_normal = Vector3(0, 1, 0);
 	rec.setFaceNormal(r, outward_normal);
 	rec.mat_ptr = m_mat_ptr;
 	rec.position = r.pointAt(t);
+	RT_STAT_INC(RectHits);
 
 	return true;
 }
@@ -257,6 +297,8 @@ bool XZRect::boundingBox(const double t0, const double t1, AABB& outputBox) cons
 
 bool YZRect::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const
 {
+	RT_STAT_INC(PrimitiveTests);
+
 	double t = (m_k - r.getOrigin().x) / r.getDirection().x;
 	if (t < tmin || t > tmax)
 		return false;
@@ -268,11 +310,13 @@ bool YZRect::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord
 
 	rec.u = (y - m_y0) / (m_y1 - m_y0);
 	rec.v = (z - m_z0) / (m_z1 - m_z0);
+	rec.uv_density = 1.0 / fmin(m_y1 - m_y0, m_z1 - m_z0);
 	rec.t = t;
 	Vector3 outward_normal = Vector3(1, 0, 0);
 	rec.setFaceNormal(r, outward_normal);
 	rec.mat_ptr = m_mat_ptr;
 	rec.position = r.pointAt(t);
+	RT_STAT_INC(RectHits);
 
 	return true;
 }
@@ -319,24 +363,94 @@ bool HittableList::boundingBox(const double t0, const double t1, AABB& outputBox
 	return true;
 }
 
-Box::Box(const Point3& p0, const Point3& p1, shared_ptr<Material> ptr)
+bool Box::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const
 {
-	m_min = p0;
-	m_max = p1;
+	RT_STAT_INC(PrimitiveTests);
 
-	m_sides.add(make_shared<XYRect>(p0.x, p1.x, p0.y, p1.y, p1.z, ptr));
-	m_sides.add(make_shared<XYRect>(p0.x, p1.x, p0.y, p1.y, p0.z, ptr));
+	const Vector3 origin = r.getOrigin();
+	const Vector3 direction = r.getDirection();
 
-	m_sides.add(make_shared<XZRect>(p0.x, p1.x, p0.z, p1.z, p1.y, ptr));
-	m_sides.add(make_shared<XZRect>(p0.x, p1.x, p0.z, p1.z, p0.y, ptr));
+	double t_enter = -infinity;
+	double t_exit = infinity;
+	int enter_axis = 0;
+	int exit_axis = 0;
 
-	m_sides.add(make_shared<YZRect>(p0.y, p1.y, p0.z, p1.z, p1.x, ptr));
-	m_sides.add(make_shared<YZRect>(p0.y, p1.y, p0.z, p1.z, p0.x, ptr));
+	for (int a = 0; a < 3; a++)
+	{
+		double inv_d = 1.0 / direction[a];
+		double t0 = (m_min[a] - origin[a]) * inv_d;
+		double t1 = (m_max[a] - origin[a]) * inv_d;
+		if (inv_d < 0.0)
+			std::swap(t0, t1);
+
+		if (t0 > t_enter) { t_enter = t0; enter_axis = a; }
+		if (t1 < t_exit) { t_exit = t1; exit_axis = a; }
+	}
+
+	if (t_enter > t_exit)
+		return false;
+
+	// Take the entry face, or the exit face when the ray starts inside.
+	double t;
+	int axis;
+	bool entering;
+	if (t_enter >= tmin && t_enter <= tmax)
+	{
+		t = t_enter;
+		axis = enter_axis;
+		entering = true;
+	}
+	else if (t_exit >= tmin && t_exit <= tmax)
+	{
+		t = t_exit;
+		axis = exit_axis;
+		entering = false;
+	}
+	else
+	{
+		return false;
+	}
+
+	rec.t = t;
+	rec.position = r.pointAt(t);
+
+	// Rays going +axis enter through the min face and leave through the max face.
+	bool max_face = (direction[axis] > 0.0) != entering;
+	Vector3 outward_normal(0, 0, 0);
+	outward_normal[axis] = max_face ? 1.0 : -1.0;
+	rec.setFaceNormal(r, outward_normal);
+
+	const int u_axis = (axis == 0) ? 1 : 0;
+	const int v_axis = (axis == 2) ? 1 : 2;
+	rec.u = (rec.position[u_axis] - m_min[u_axis]) / (m_max[u_axis] - m_min[u_axis]);
+	rec.v = (rec.position[v_axis] - m_min[v_axis]) / (m_max[v_axis] - m_min[v_axis]);
+	rec.uv_density = 1.0 / fmin(m_max[u_axis] - m_min[u_axis], m_max[v_axis] - m_min[v_axis]);
+	rec.mat_ptr = m_mat_ptr;
+	RT_STAT_INC(BoxHits);
+
+	return true;
 }
 
-bool Box::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const
+bool Box::hitSpan(const Ray& r, double& t_enter, double& t_exit) const
 {
-	return m_sides.hit(r, tmin, tmax, rec);
+	const Vector3 origin = r.getOrigin();
+	const Vector3 direction = r.getDirection();
+
+	t_enter = -infinity;
+	t_exit = infinity;
+	for (int a = 0; a < 3; a++)
+	{
+		double inv_d = 1.0 / direction[a];
+		double t0 = (m_min[a] - origin[a]) * inv_d;
+		double t1 = (m_max[a] - origin[a]) * inv_d;
+		if (inv_d < 0.0)
+			std::swap(t0, t1);
+
+		t_enter = fmax(t_enter, t0);
+		t_exit = fmin(t_exit, t1);
+	}
+
+	return t_enter <= t_exit;
 }
 
 bool Box::boundingBox(const double t0, const double t1, AABB& outputBox) const
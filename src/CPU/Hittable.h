@@ -16,6 +16,8 @@ struct HitRecord
 	double t;
 	double u;
 	double v;
+	double uv_density;	// uv units per world unit around the hit, 0 if unknown
+	double footprint;	// texture filter width in uv units, set by the integrator
 	bool front_face;
 
 	inline void setFaceNormal(const Ray& r, const Vector3& outward_normal)
@@ -34,38 +36,66 @@ public:
 	
 	virtual bool hit(const Ray& r, const double& t_min, const double& t_max, HitRecord& rec) const = 0;
 	virtual bool boundingBox(const double t0, const double t1, AABB& outputBox) const = 0;
+
+	// Entry and exit parameters of the ray's span inside a closed shape,
+	// unclipped (t_enter may be negative when the origin is inside). The
+	// default makes two hit() queries; convex shapes answer in one test.
+	virtual bool hitSpan(const Ray& r, double& t_enter, double& t_exit) const;
 };
 
-class Translate : public Hittable
+// An affine transform with its inverse and normal matrix cached, and the
+// ray/hit mapping shared by Transform and TLAS instances.
+struct Placement
 {
-public:
-	Translate(shared_ptr<Hittable> p, const Vector3& displacement)
-		: m_ptr(p), m_offset(displacement) {}
+	Placement() = default;
+	// Throws std::invalid_argument if to_world is singular.
+	explicit Placement(const Matrix34& to_world);
 
-	virtual bool hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const override;
-	virtual bool boundingBox(const double t0, const double t1, AABB& outputBox) const override;
+	// Moves a world-space ray into object space. Ray normalizes its
+	// direction, so object-space distances are world-space ones times scale.
+	Ray toObject(const Ray& r, double& scale) const;
 
-public:
-	shared_ptr<Hittable> m_ptr;
-	Vector3 m_offset;
+	// Moves an object-space hit found with toObject back to world space.
+	void toWorld(HitRecord& rec, double scale) const;
+
+	Matrix34 to_world;
+	Matrix34 to_object;
+	Matrix34 normal_matrix;	// inverse transpose of the linear part
 };
 
-class RotateY : public Hittable
+// Affine placement of another hittable. Rays are moved into object space
+// once per call; nesting Transforms is folded into a single matrix when the
+// outer one is constructed.
+class Transform : public Hittable
 {
 public:
-	RotateY(shared_ptr<Hittable> p, double angle);
+	Transform(shared_ptr<Hittable> p, const Matrix34& to_world);
 
 	virtual bool hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const override;
 	virtual bool boundingBox(const double t0, const double t1, AABB& outputBox) const override;
+	virtual bool hitSpan(const Ray& r, double& t_enter, double& t_exit) const override;
 
 public:
 	shared_ptr<Hittable> m_ptr;
-	double m_sin_theta;
-	double m_cos_theta;
+	Placement m_placement;
 	bool m_hasbox;
 	AABB m_bbox;
 };
 
+class Translate : public Transform
+{
+public:
+	Translate(shared_ptr<Hittable> p, const Vector3& displacement)
+		: Transform(p, Matrix34::translation(displacement)) {}
+};
+
+class RotateY : public Transform
+{
+public:
+	RotateY(shared_ptr<Hittable> p, double angle)
+		: Transform(p, Matrix34::rotationY(angle)) {}
+};
+
 class Sphere : public Hittable
 {
 public:
@@ -74,6 +104,7 @@ public:
 
 	virtual bool hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const override;
 	virtual bool boundingBox(const double t0, const double t1, AABB& outputBox) const override;
+	virtual bool hitSpan(const Ray& r, double& t_enter, double& t_exit) const override;
 
 	static void getSphereUV(const Vector3& p, double& u, double& v)
 	{
@@ -83,6 +114,14 @@ public:
 		v = (theta + pi / 2) / pi;
 	}
 
+	// Inverse of getSphereUV: the unit-sphere point with the given uv.
+	static Point3 getSpherePoint(double u, double v)
+	{
+		double phi = (1 - u) * 2 * pi - pi;
+		double theta = v * pi - pi / 2;
+		return Point3(cos(theta) * cos(phi), sin(theta), cos(theta) * sin(phi));
+	}
+
 public:
 	Point3 m_center;
 	double m_radius;
@@ -173,19 +212,23 @@ public:
 	std::vector<std::shared_ptr<Hittable>> m_list;
 };
 
+// Axis-aligned box intersected with a single slab test. Face UVs follow the
+// XYRect/XZRect/YZRect conventions.
 class Box : public Hittable
 {
 public:
 	Box() {}
-	Box(const Point3& p0, const Point3& p1, shared_ptr<Material> ptr);
+	Box(const Point3& p0, const Point3& p1, shared_ptr<Material> ptr)
+		: m_min(p0), m_max(p1), m_mat_ptr(ptr) {}
 
 	virtual bool hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const override;
 	virtual bool boundingBox(const double t0, const double t1, AABB& outputBox) const override;
+	virtual bool hitSpan(const Ray& r, double& t_enter, double& t_exit) const override;
 
 public:
 	Point3 m_min;
 	Point3 m_max;
-	HittableList m_sides;
+	shared_ptr<Material> m_mat_ptr;
 };
 
 #endif // !HITTABLE_H
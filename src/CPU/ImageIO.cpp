@@ -0,0 +1,276 @@
+#include "ImageIO.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "External/stb_image_write.h"
+
+// All binary formats here are little-endian, as is every platform we build for.
+
+namespace
+{
+	uint16_t floatToHalf(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		const uint32_t sign = (bits >> 16) & 0x8000;
+		const uint32_t exponent = (bits >> 23) & 0xff;
+		uint32_t mantissa = bits & 0x7fffff;
+
+		// Inf and NaN
+		if (exponent == 0xff)
+			return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+		const int e = static_cast<int>(exponent) - 127 + 15;
+		if (e >= 31)
+			return static_cast<uint16_t>(sign | 0x7c00);
+
+		// Subnormal halves, rounded to nearest even.
+		if (e <= 0)
+		{
+			if (e < -10)
+				return static_cast<uint16_t>(sign);
+
+			mantissa |= 0x800000;
+			const int shift = 14 - e;
+			uint32_t half = mantissa >> shift;
+			const uint32_t rest = mantissa & ((1u << shift) - 1);
+			const uint32_t halfway = 1u << (shift - 1);
+			if (rest > halfway || (rest == halfway && (half & 1)))
+				half++;
+			return static_cast<uint16_t>(sign | half);
+		}
+
+		// A carry out of the mantissa correctly bumps the exponent.
+		uint32_t half = sign | (static_cast<uint32_t>(e) << 10) | (mantissa >> 13);
+		const uint32_t rest = mantissa & 0x1fff;
+		if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+			half++;
+		return static_cast<uint16_t>(half);
+	}
+
+	// Little-endian byte sink for the EXR header.
+	class ByteWriter
+	{
+	public:
+		template<typename T>
+		void put(const T& value)
+		{
+			const char* bytes = reinterpret_cast<const char*>(&value);
+			m_bytes.insert(m_bytes.end(), bytes, bytes + sizeof(T));
+		}
+
+		void putString(const char* s) { m_bytes.insert(m_bytes.end(), s, s + strlen(s) + 1); }
+
+		void putAttribute(const char* name, const char* type, uint32_t size)
+		{
+			putString(name);
+			putString(type);
+			put(size);
+		}
+
+		const std::vector<char>& getBytes() const { return m_bytes; }
+
+	private:
+		std::vector<char> m_bytes;
+	};
+}
+
+bool writeEXR(const char* filename, int width, int height, std::vector<ImageChannel> channels)
+{
+	// The channel list has to be sorted by name.
+	std::sort(channels.begin(), channels.end(), [](const ImageChannel& a, const ImageChannel& b)
+	{
+		return a.name < b.name;
+	});
+
+	ByteWriter header;
+	header.put(uint32_t(20000630));	// magic
+	header.put(uint32_t(2));		// version 2, single-part scanline
+
+	uint32_t chlist_size = 1;
+	for (const ImageChannel& channel : channels)
+		chlist_size += static_cast<uint32_t>(channel.name.size()) + 1 + 16;
+	header.putAttribute("channels", "chlist", chlist_size);
+	for (const ImageChannel& channel : channels)
+	{
+		header.putString(channel.name.c_str());
+		header.put(int32_t(channel.half ? 1 : 2));	// pixel type
+		header.put(uint32_t(0));					// pLinear and reserved
+		header.put(int32_t(1));						// x sampling
+		header.put(int32_t(1));						// y sampling
+	}
+	header.put(char(0));
+
+	header.putAttribute("compression", "compression", 1);
+	header.put(char(0));	// NO_COMPRESSION
+
+	const int32_t window[4] = { 0, 0, width - 1, height - 1 };
+	header.putAttribute("dataWindow", "box2i", 16);
+	header.put(window);
+	header.putAttribute("displayWindow", "box2i", 16);
+	header.put(window);
+
+	header.putAttribute("lineOrder", "lineOrder", 1);
+	header.put(char(0));	// INCREASING_Y
+
+	header.putAttribute("pixelAspectRatio", "float", 4);
+	header.put(1.0f);
+
+	const float window_center[2] = { 0.0f, 0.0f };
+	header.putAttribute("screenWindowCenter", "v2f", 8);
+	header.put(window_center);
+
+	header.putAttribute("screenWindowWidth", "float", 4);
+	header.put(1.0f);
+
+	header.put(char(0));	// end of header
+
+	// One scanline per chunk, so the offset table is known up front.
+	size_t line_bytes = 0;
+	for (const ImageChannel& channel : channels)
+		line_bytes += static_cast<size_t>(width) * (channel.half ? 2 : 4);
+
+	const uint64_t first_chunk = header.getBytes().size() + static_cast<uint64_t>(height) * sizeof(uint64_t);
+	std::vector<uint64_t> offsets(height);
+	for (int y = 0; y < height; y++)
+		offsets[y] = first_chunk + static_cast<uint64_t>(y) * (8 + line_bytes);
+
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Could not open EXR for writing->" << filename << std::endl;
+		return false;
+	}
+
+	file.write(header.getBytes().data(), header.getBytes().size());
+	file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+
+	std::vector<char> line(8 + line_bytes);
+	for (int y = 0; y < height; y++)
+	{
+		const int32_t chunk_header[2] = { y, static_cast<int32_t>(line_bytes) };
+		memcpy(line.data(), chunk_header, sizeof(chunk_header));
+
+		char* out = line.data() + 8;
+		for (const ImageChannel& channel : channels)
+		{
+			const float* in = channel.data + static_cast<size_t>(y) * width * channel.stride;
+			for (int x = 0; x < width; x++, in += channel.stride)
+			{
+				if (channel.half)
+				{
+					uint16_t h = floatToHalf(*in);
+					memcpy(out, &h, sizeof(h));
+					out += sizeof(h);
+				}
+				else
+				{
+					memcpy(out, in, sizeof(float));
+					out += sizeof(float);
+				}
+			}
+		}
+
+		file.write(line.data(), line.size());
+	}
+
+	if (!file)
+	{
+		std::cerr << "Failed writing EXR->" << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool writeEXR(const char* filename, const Framebuffer& image, bool half)
+{
+	const float* data = image.getData();
+	return writeEXR(filename, image.getWidth(), image.getHeight(), {
+		{ "R", data + 0, 3, half },
+		{ "G", data + 1, 3, half },
+		{ "B", data + 2, 3, half } });
+}
+
+bool writePFM(const char* filename, const Framebuffer& image)
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Could not open PFM for writing->" << filename << std::endl;
+		return false;
+	}
+
+	// A negative scale marks little-endian data. Rows go bottom to top.
+	file << "PF\n" << image.getWidth() << ' ' << image.getHeight() << "\n-1.0\n";
+	const size_t row_floats = static_cast<size_t>(image.getWidth()) * 3;
+	for (int y = image.getHeight() - 1; y >= 0; y--)
+		file.write(reinterpret_cast<const char*>(image.getData() + y * row_floats), row_floats * sizeof(float));
+
+	if (!file)
+	{
+		std::cerr << "Failed writing PFM->" << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool readPFM(const char* filename, Framebuffer& image)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Could not open PFM->" << filename << std::endl;
+		return false;
+	}
+
+	std::string magic;
+	int width = 0, height = 0;
+	double scale = 0.0;
+	file >> magic >> width >> height >> scale;
+	file.get();		// the single whitespace byte before the data
+	if (!file || magic != "PF" || width <= 0 || height <= 0 || scale == 0.0)
+	{
+		std::cerr << "Not a three-channel PFM->" << filename << std::endl;
+		return false;
+	}
+
+	image.resize(width, height);
+	const size_t row_floats = static_cast<size_t>(width) * 3;
+	for (int y = height - 1; y >= 0; y--)
+		file.read(reinterpret_cast<char*>(image.getData() + y * row_floats), row_floats * sizeof(float));
+
+	if (!file)
+	{
+		std::cerr << "Failed reading PFM->" << filename << std::endl;
+		return false;
+	}
+
+	// A positive scale marks big-endian data.
+	if (scale > 0.0)
+	{
+		float* data = image.getData();
+		for (size_t i = 0; i < row_floats * height; i++)
+		{
+			uint32_t bits;
+			memcpy(&bits, &data[i], sizeof(bits));
+			bits = (bits >> 24) | ((bits >> 8) & 0xff00) | ((bits << 8) & 0xff0000) | (bits << 24);
+			memcpy(&data[i], &bits, sizeof(bits));
+		}
+	}
+	return true;
+}
+
+bool writePNG(const char* filename, int width, int height, const unsigned char* rgba)
+{
+	if (!stbi_write_png(filename, width, height, 4, rgba, width * 4))
+	{
+		std::cerr << "Failed writing PNG->" << filename << std::endl;
+		return false;
+	}
+	return true;
+}
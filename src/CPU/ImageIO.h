@@ -0,0 +1,31 @@
+#ifndef IMAGE_IO_H
+#define IMAGE_IO_H
+
+#include <string>
+#include <vector>
+
+#include "Framebuffer.h"
+
+// One channel of an EXR image: element (x, y) is data[(y * width + x) * stride].
+struct ImageChannel
+{
+	std::string name;	// e.g. "R", "albedo.G", "Z"
+	const float* data;
+	size_t stride;
+	bool half;			// store as 16-bit half instead of 32-bit float
+};
+
+// Image writers. They return false and report to std::cerr on failure.
+//
+// EXR output is single-part scanline, uncompressed, with any number of
+// channels; PFM is the three-channel little-endian float format.
+bool writeEXR(const char* filename, int width, int height, std::vector<ImageChannel> channels);
+bool writeEXR(const char* filename, const Framebuffer& image, bool half = false);
+bool writePFM(const char* filename, const Framebuffer& image);
+bool writePNG(const char* filename, int width, int height, const unsigned char* rgba);
+
+// Reads a three-channel PFM of either byte order into image. Returns false
+// and reports to std::cerr on failure.
+bool readPFM(const char* filename, Framebuffer& image);
+
+#endif // !IMAGE_IO_H
@@ -0,0 +1,131 @@
+#include "ImageOutput.h"
+
+#include <vector>
+
+#include <tbb/task_group.h>
+
+#include "ImageIO.h"
+#include "Stats.h"
+#include "Trace.h"
+
+ImageOutput::ImageOutput(size_t max_pending)
+	: m_max_pending(max(max_pending, size_t(1)))
+{
+	m_thread = std::thread(&ImageOutput::run, this);
+}
+
+ImageOutput::~ImageOutput()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_work.notify_all();
+	m_thread.join();
+}
+
+void ImageOutput::submit(Framebuffer image, const std::string& basename, unsigned formats, const DisplayTransform& display)
+{
+	submit(std::move(image), AOVBuffer(), basename, formats, display);
+}
+
+void ImageOutput::submit(Framebuffer image, AOVBuffer aovs, const std::string& basename, unsigned formats, const DisplayTransform& display)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_space.wait(lock, [this] { return m_jobs.size() < m_max_pending; });
+		m_jobs.push_back({ std::move(image), std::move(aovs), basename, formats, display });
+	}
+	m_work.notify_one();
+}
+
+void ImageOutput::flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this] { return m_jobs.empty() && !m_busy; });
+}
+
+size_t ImageOutput::getWrittenCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_written;
+}
+
+void ImageOutput::run()
+{
+	Trace::setThreadName("output");
+
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_work.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+
+			// Pending frames are still written when stopping.
+			if (m_jobs.empty())
+				return;
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+			m_busy = true;
+		}
+		m_space.notify_one();
+
+		write(job);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_busy = false;
+			m_written++;
+		}
+		m_idle.notify_all();
+	}
+}
+
+void ImageOutput::write(const Job& job)
+{
+	Stats::ScopedTimer timer(Stats::Encode);
+	tbb::task_group formats;
+
+	if (job.formats & PNG)
+	{
+		formats.run([&job]
+		{
+			std::vector<unsigned char> rgba(static_cast<size_t>(job.image.getWidth()) * job.image.getHeight() * 4);
+			{
+				Trace::Scope span("convert RGBA8", "output");
+				encodeRGBA8(job.image, job.display, rgba.data());
+			}
+			Trace::Scope span("encode and write PNG", "output");
+			writePNG((job.basename + ".png").c_str(), job.image.getWidth(), job.image.getHeight(), rgba.data());
+		});
+	}
+
+	if (job.formats & EXR)
+	{
+		formats.run([&job]
+		{
+			Trace::Scope span("write EXR", "output");
+			const float* rgb = job.image.getData();
+			std::vector<ImageChannel> channels = {
+				{ "R", rgb + 0, 3, false },
+				{ "G", rgb + 1, 3, false },
+				{ "B", rgb + 2, 3, false } };
+			if (!job.aovs.isEmpty())
+				job.aovs.appendChannels(channels);
+			writeEXR((job.basename + ".exr").c_str(), job.image.getWidth(), job.image.getHeight(), channels);
+		});
+	}
+
+	if (job.formats & PFM)
+	{
+		formats.run([&job]
+		{
+			Trace::Scope span("write PFM", "output");
+			writePFM((job.basename + ".pfm").c_str(), job.image);
+		});
+	}
+
+	formats.wait();
+}
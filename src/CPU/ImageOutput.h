@@ -0,0 +1,81 @@
+#ifndef IMAGE_OUTPUT_H
+#define IMAGE_OUTPUT_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "AOV.h"
+#include "Framebuffer.h"
+
+// Output stage on its own thread. Finished frames and progressive
+// checkpoints are handed over with submit() and converted, tonemapped and
+// written to disk while the caller goes on rendering. The formats of one
+// frame are encoded concurrently, and the display conversion runs in
+// parallel over rows.
+class ImageOutput
+{
+public:
+	enum Format
+	{
+		PNG = 1 << 0,
+		EXR = 1 << 1,
+		PFM = 1 << 2
+	};
+
+	// At most max_pending frames wait in the queue; submit() blocks beyond
+	// that so checkpoints cannot pile up faster than they are written.
+	explicit ImageOutput(size_t max_pending = 2);
+
+	// Writes everything still queued.
+	~ImageOutput();
+
+	ImageOutput(const ImageOutput&) = delete;
+	ImageOutput& operator=(const ImageOutput&) = delete;
+
+	// Queues image for writing as <basename>.png/.exr/.pfm for each format
+	// in formats. The image is copied (or moved), so the caller may keep
+	// rendering into its own framebuffer.
+	void submit(Framebuffer image, const std::string& basename, unsigned formats,
+		const DisplayTransform& display = DisplayTransform());
+
+	// As above; the EXR additionally carries every AOV channel.
+	void submit(Framebuffer image, AOVBuffer aovs, const std::string& basename, unsigned formats,
+		const DisplayTransform& display = DisplayTransform());
+
+	// Blocks until every submitted frame has been written.
+	void flush();
+
+	size_t getWrittenCount() const;
+
+private:
+	struct Job
+	{
+		Framebuffer image;
+		AOVBuffer aovs;
+		std::string basename;
+		unsigned formats;
+		DisplayTransform display;
+	};
+
+	void run();
+	static void write(const Job& job);
+
+private:
+	const size_t m_max_pending;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_work;		// a job was queued or stopping
+	std::condition_variable m_space;	// a job was taken off the queue
+	std::condition_variable m_idle;		// the queue drained
+	std::deque<Job> m_jobs;
+	bool m_busy = false;
+	bool m_stop = false;
+	size_t m_written = 0;
+
+	std::thread m_thread;
+};
+
+#endif // !IMAGE_OUTPUT_H
@@ -0,0 +1,154 @@
+#include "Instance.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+uint32_t TLAS::addBLAS(shared_ptr<Hittable> blas)
+{
+	m_blas.push_back(blas);
+	return static_cast<uint32_t>(m_blas.size() - 1);
+}
+
+void TLAS::addInstance(uint32_t blas, const Matrix34& to_world)
+{
+	if (blas >= m_blas.size())
+		throw std::out_of_range("Error: TLAS instance refers to an unknown BLAS!");
+
+	Instance instance;
+	instance.placement = Placement(to_world);
+	instance.blas = blas;
+	m_instances.push_back(instance);
+}
+
+void TLAS::build(double t0, double t1)
+{
+	Stats::ScopedTimer timer(Stats::BVHBuild);
+
+	m_blas_boxes.resize(m_blas.size());
+	for (size_t i = 0; i < m_blas.size(); i++)
+	{
+		if (!m_blas[i]->boundingBox(t0, t1, m_blas_boxes[i]))
+			std::cerr << "No bounding box in TLAS::build.\n";
+	}
+
+	for (auto& instance : m_instances)
+		instance.world_box = AABB::transformBox(m_blas_boxes[instance.blas], instance.placement.to_world);
+
+	m_nodes.clear();
+	if (m_instances.empty())
+		return;
+
+	m_nodes.reserve(2 * m_instances.size());
+	buildNode(0, static_cast<uint32_t>(m_instances.size()));
+}
+
+uint32_t TLAS::buildNode(uint32_t begin, uint32_t end)
+{
+	uint32_t index = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.emplace_back();
+
+	Node node;
+	node.box = m_instances[begin].world_box;
+	AABB centroids(node.box.getMin() + node.box.getMax(), node.box.getMin() + node.box.getMax());
+	for (uint32_t i = begin + 1; i < end; i++)
+	{
+		const AABB& box = m_instances[i].world_box;
+		node.box = AABB::surroundingBox(node.box, box);
+		Point3 c = box.getMin() + box.getMax();
+		centroids = AABB::surroundingBox(centroids, AABB(c, c));
+	}
+
+	uint32_t count = end - begin;
+	if (count <= max_leaf_size)
+	{
+		node.offset = begin;
+		node.count = count;
+		m_nodes[index] = node;
+		return index;
+	}
+
+	Vector3 extent = centroids.getMax() - centroids.getMin();
+	int axis = 0;
+	if (extent.y > extent[axis]) axis = 1;
+	if (extent.z > extent[axis]) axis = 2;
+
+	uint32_t mid = begin + count / 2;
+	std::nth_element(m_instances.begin() + begin, m_instances.begin() + mid, m_instances.begin() + end,
+		[axis](const Instance& a, const Instance& b)
+		{
+			return a.world_box.getMin()[axis] + a.world_box.getMax()[axis]
+				< b.world_box.getMin()[axis] + b.world_box.getMax()[axis];
+		});
+
+	buildNode(begin, mid);	// left child is always index + 1
+	node.offset = buildNode(mid, end);
+	node.count = 0;
+	m_nodes[index] = node;
+
+	return index;
+}
+
+bool TLAS::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const
+{
+	if (m_nodes.empty())
+		return false;
+
+	uint32_t stack[64];
+	int stack_size = 0;
+	uint32_t current = 0;
+	double closest_so_far = tmax;
+	bool hit_anything = false;
+
+	while (true)
+	{
+		const Node& node = m_nodes[current];
+		RT_STAT_INC(BVHNodesVisited);
+		if (node.box.hit(r, tmin, closest_so_far))
+		{
+			if (node.count == 0)
+			{
+				stack[stack_size++] = node.offset;
+				RT_STAT_STACK_DEPTH(stack_size);
+				current = current + 1;
+				continue;
+			}
+
+			for (uint32_t i = 0; i < node.count; i++)
+			{
+				if (hitInstance(m_instances[node.offset + i], r, tmin, closest_so_far, rec))
+				{
+					hit_anything = true;
+					closest_so_far = rec.t;
+				}
+			}
+		}
+
+		if (stack_size == 0)
+			break;
+		current = stack[--stack_size];
+	}
+
+	return hit_anything;
+}
+
+bool TLAS::hitInstance(const Instance& instance, const Ray& r, double tmin, double tmax, HitRecord& rec) const
+{
+	double scale;
+	Ray object_r = instance.placement.toObject(r, scale);
+
+	if (!m_blas[instance.blas]->hit(object_r, tmin * scale, tmax * scale, rec))
+		return false;
+
+	instance.placement.toWorld(rec, scale);
+	return true;
+}
+
+bool TLAS::boundingBox(const double t0, const double t1, AABB& outputBox) const
+{
+	if (m_nodes.empty())
+		return false;
+
+	outputBox = m_nodes[0].box;
+	return true;
+}
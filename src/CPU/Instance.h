@@ -0,0 +1,60 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include <cstdint>
+
+#include "Hittable.h"
+#include "Math/Matrix34.h"
+
+// One placement of a shared bottom-level structure (BLAS).
+struct Instance
+{
+	Placement placement;
+	AABB world_box;
+	uint32_t blas;
+};
+
+// Two-level acceleration structure. Unique geometry is added once as a BLAS
+// (usually a BVHNode or TriangleMesh) and placed any number of times with an
+// affine transform. The top level is a flat BVH over instance world bounds;
+// rays are moved into object space only when they reach an instance.
+class TLAS : public Hittable
+{
+public:
+	TLAS() = default;
+
+	uint32_t addBLAS(shared_ptr<Hittable> blas);
+	// blas is an index returned by addBLAS. Throws std::out_of_range for any
+	// other index and std::invalid_argument if to_world is singular.
+	void addInstance(uint32_t blas, const Matrix34& to_world);
+
+	// Must be called after the last addInstance and before rendering.
+	void build(double t0, double t1);
+
+	size_t getBLASCount() const { return m_blas.size(); }
+	size_t getInstanceCount() const { return m_instances.size(); }
+
+	virtual bool hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const override;
+	virtual bool boundingBox(const double t0, const double t1, AABB& outputBox) const override;
+
+private:
+	static const int max_leaf_size = 2;
+
+	struct Node
+	{
+		AABB box;
+		uint32_t offset;	// first instance for a leaf, right child otherwise
+		uint32_t count;		// instance count, 0 for inner nodes
+	};
+
+	uint32_t buildNode(uint32_t begin, uint32_t end);
+	bool hitInstance(const Instance& instance, const Ray& r, double tmin, double tmax, HitRecord& rec) const;
+
+private:
+	std::vector<shared_ptr<Hittable>> m_blas;
+	std::vector<AABB> m_blas_boxes;
+	std::vector<Instance> m_instances;
+	std::vector<Node> m_nodes;
+};
+
+#endif // !INSTANCE_H
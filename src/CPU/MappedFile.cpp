@@ -0,0 +1,108 @@
+#include "MappedFile.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::open(const char* filename)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		std::cerr << "Failed to open the file->" << filename << std::endl;
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	GetFileSizeEx(file, &size);
+	m_file = file;
+	m_size = static_cast<size_t>(size.QuadPart);
+
+	if (m_size > 0)
+	{
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (view == nullptr)
+		{
+			std::cerr << "Failed to map the file->" << filename << std::endl;
+			if (mapping) CloseHandle(mapping);
+			CloseHandle(file);
+			m_file = nullptr;
+			m_size = 0;
+			return false;
+		}
+		m_mapping = mapping;
+		m_data = static_cast<const char*>(view);
+	}
+#else
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		std::cerr << "Failed to open the file->" << filename << std::endl;
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		std::cerr << "Failed to read the file size->" << filename << std::endl;
+		::close(fd);
+		return false;
+	}
+	m_fd = fd;
+	m_size = static_cast<size_t>(st.st_size);
+
+	if (m_size > 0)
+	{
+		void* view = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view == MAP_FAILED)
+		{
+			std::cerr << "Failed to map the file->" << filename << std::endl;
+			::close(fd);
+			m_fd = -1;
+			m_size = 0;
+			return false;
+		}
+		madvise(view, m_size, MADV_SEQUENTIAL);
+		m_data = static_cast<const char*>(view);
+	}
+#endif
+
+	m_open = true;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (!m_open)
+		return;
+
+#ifdef _WIN32
+	if (m_data) UnmapViewOfFile(m_data);
+	if (m_mapping) CloseHandle(m_mapping);
+	if (m_file) CloseHandle(m_file);
+	m_mapping = nullptr;
+	m_file = nullptr;
+#else
+	if (m_data) munmap(const_cast<char*>(m_data), m_size);
+	::close(m_fd);
+	m_fd = -1;
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+	m_open = false;
+}
@@ -0,0 +1,36 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const char* filename) { open(filename); }
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const char* filename);
+	void close();
+
+	bool isOpen() const { return m_open; }
+	const char* getData() const { return m_data; }
+	size_t getSize() const { return m_size; }
+
+private:
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+	bool m_open = false;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#else
+	int m_fd = -1;
+#endif
+};
+
+#endif // !MAPPED_FILE_H
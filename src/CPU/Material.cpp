@@ -4,10 +4,25 @@ bool Lambertian::scatter(const Ray& r_in, const HitRecord& rec, Color& attenuati
 {
 	Vector3 scatter_direction = rec.normal + Vector3::randomUnitVector();
 	scattered = Ray(rec.position, scatter_direction, r_in.getTime());
-	attenuation = m_albedo->value(rec.u, rec.v, rec.position);
+	attenuation = m_albedo->value(rec.u, rec.v, rec.position, rec.footprint);
 	return true;
 }
 
+Color Lambertian::albedo(const HitRecord& rec) const
+{
+	return m_albedo->value(rec.u, rec.v, rec.position, rec.footprint);
+}
+
+void Lambertian::bakeAlbedo(int width, int height, const BakedTexture::SurfaceMap& surface)
+{
+	m_albedo = make_shared<BakedTexture>(m_albedo, width, height, surface);
+}
+
+void Lambertian::bakeAlbedo(const AABB& bounds, int resolution)
+{
+	m_albedo = make_shared<BakedTexture>(m_albedo, bounds, resolution);
+}
+
 bool Metal::scatter(const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scattered) const
 {
 	Vector3 reflected = Vector3::reflect(r_in.getDirection().getNormalied(), rec.normal);
@@ -49,6 +64,11 @@ bool Dielectric::scatter(const Ray& r_in, const HitRecord& rec, Color& attenuati
 bool Isotropic::scatter(const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scattered) const
 {
 	scattered = Ray(rec.position, Vector3::randomInUnitSphere(), r_in.getTime());
-	attenuation = m_albedo->value(rec.u, rec.v, rec.position);
+	attenuation = m_albedo->value(rec.u, rec.v, rec.position, rec.footprint);
 	return true;
-}
\ No newline at end of file
+}
+
+Color Isotropic::albedo(const HitRecord& rec) const
+{
+	return m_albedo->value(rec.u, rec.v, rec.position, rec.footprint);
+}
@@ -7,12 +7,30 @@
 class Material
 {
 public:
+	virtual ~Material() = default;
+
 	virtual bool scatter(const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scattered) const = 0;
 
 	virtual Color emitted(double u, double v, const Point3& p) const 
 	{
 		return Color(0, 0, 0);
 	}
+
+	// Surface color seen by the albedo AOV at a camera ray's first hit.
+	virtual Color albedo(const HitRecord& rec) const
+	{
+		return Color(0, 0, 0);
+	}
+
+	// Numbered from 1 by the SceneArena that made the material, in the order
+	// the scene made them, so the ID does not depend on anything else built
+	// in the process. Materials made outside an arena keep 0.
+	int getID() const { return m_id; }
+
+private:
+	friend class SceneArena;
+
+	int m_id = 0;
 };
 
 class Lambertian : public Material
@@ -24,6 +42,12 @@ public:
 	virtual ~Lambertian() = default;
 
 	virtual bool scatter(const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scattered) const override;
+	virtual Color albedo(const HitRecord& rec) const override;
+
+	// Replace the albedo with a baked copy (see BakedTexture). Meant for
+	// expensive procedural albedos; call before rendering starts.
+	void bakeAlbedo(int width, int height, const BakedTexture::SurfaceMap& surface);
+	void bakeAlbedo(const AABB& bounds, int resolution);
 
 private:
 	shared_ptr<Texture> m_albedo;
@@ -36,6 +60,7 @@ public:
 	virtual ~Metal() = default;
 
 	virtual bool scatter(const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scattered) const override;
+	virtual Color albedo(const HitRecord& rec) const override { return m_albedo; }
 
 public:
 	Color m_albedo;
@@ -49,6 +74,7 @@ public:
 	virtual ~Dielectric() = default;
 
 	virtual bool scatter(const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scattered) const override;
+	virtual Color albedo(const HitRecord& rec) const override { return Color(1, 1, 1); }
 
 private:
 	double ref_idx;
@@ -77,6 +103,12 @@ public:
 		return m_emit->value(u, v, p);
 	}
 
+	virtual Color albedo(const HitRecord& rec) const override
+	{
+		Color c = m_emit->value(rec.u, rec.v, rec.position);
+		return Color(fmin(c.x, 1.0), fmin(c.y, 1.0), fmin(c.z, 1.0));
+	}
+
 public:
 	shared_ptr<Texture> m_emit;
 };
@@ -88,6 +120,7 @@ public:
 	Isotropic(shared_ptr<Texture> a) : m_albedo(a) {}
 
 	virtual bool scatter(const Ray& r_in, const HitRecord& rec, Color& attenuation, Ray& scattered) const override;
+	virtual Color albedo(const HitRecord& rec) const override;
 
 public:
 	shared_ptr<Texture> m_albedo;
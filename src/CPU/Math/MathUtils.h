@@ -19,12 +19,25 @@ const double infinity = std::numeric_limits<double>::infinity();
 const double pi = 3.1415926535897932385;
 
 // Random Number Utilities
+// Every thread has its own generator, so render threads neither race on nor
+// contend for a shared state. Reseeding it with random_seed() makes a
+// thread's sequence reproducible.
+inline std::mt19937& random_generator()
+{
+	thread_local std::mt19937 generator;
+	return generator;
+}
+
+inline void random_seed(uint seed)
+{
+	random_generator().seed(seed);
+}
+
 inline double random_double()
 {
 	// Returns a random real in [0,1).
-	static std::uniform_real_distribution<double> distribution(0.0, 1.0);
-	static std::mt19937 generator;
-	return distribution(generator);
+	thread_local std::uniform_real_distribution<double> distribution(0.0, 1.0);
+	return distribution(random_generator());
 }
 
 inline double random_double(double min, double max)
@@ -0,0 +1,180 @@
+#ifndef MATRIX34_H
+#define MATRIX34_H
+
+#include <cassert>
+
+#include "Vector3.h"
+
+// Row-major 3x4 affine matrix: a 3x3 linear part plus a translation column.
+class Matrix34
+{
+public:
+	Matrix34() : Matrix34(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0) {}
+	Matrix34(
+		double m00, double m01, double m02, double m03,
+		double m10, double m11, double m12, double m13,
+		double m20, double m21, double m22, double m23)
+	{
+		m[0][0] = m00; m[0][1] = m01; m[0][2] = m02; m[0][3] = m03;
+		m[1][0] = m10; m[1][1] = m11; m[1][2] = m12; m[1][3] = m13;
+		m[2][0] = m20; m[2][1] = m21; m[2][2] = m22; m[2][3] = m23;
+	}
+
+	// factories
+	static Matrix34 identity() { return Matrix34(); }
+
+	static Matrix34 translation(const Vector3& offset)
+	{
+		return Matrix34(
+			1, 0, 0, offset.x,
+			0, 1, 0, offset.y,
+			0, 0, 1, offset.z);
+	}
+
+	static Matrix34 scaling(const Vector3& s)
+	{
+		return Matrix34(
+			s.x, 0, 0, 0,
+			0, s.y, 0, 0,
+			0, 0, s.z, 0);
+	}
+
+	// Rotation by angle (degrees) around an arbitrary axis.
+	static Matrix34 rotation(const Vector3& axis, double angle)
+	{
+		Vector3 a = axis.getNormalied();
+		double radians = degreeToRadian(angle);
+		double s = sin(radians);
+		double c = cos(radians);
+		double t = 1.0 - c;
+
+		return Matrix34(
+			t * a.x * a.x + c,       t * a.x * a.y - s * a.z, t * a.x * a.z + s * a.y, 0,
+			t * a.x * a.y + s * a.z, t * a.y * a.y + c,       t * a.y * a.z - s * a.x, 0,
+			t * a.x * a.z - s * a.y, t * a.y * a.z + s * a.x, t * a.z * a.z + c,       0);
+	}
+
+	static Matrix34 rotationY(double angle)
+	{
+		double radians = degreeToRadian(angle);
+		double s = sin(radians);
+		double c = cos(radians);
+
+		return Matrix34(
+			 c, 0, s, 0,
+			 0, 1, 0, 0,
+			-s, 0, c, 0);
+	}
+
+	// transforms
+	inline Point3 transformPoint(const Point3& p) const
+	{
+		return Point3(
+			m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+			m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+			m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3]);
+	}
+
+	inline Vector3 transformVector(const Vector3& v) const
+	{
+		return Vector3(
+			m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+			m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+			m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z);
+	}
+
+	// Multiplies by the transposed linear part. Called on the inverse matrix
+	// this maps normals, since normals transform with the inverse transpose.
+	inline Vector3 transformNormal(const Vector3& n) const
+	{
+		return Vector3(
+			m[0][0] * n.x + m[1][0] * n.y + m[2][0] * n.z,
+			m[0][1] * n.x + m[1][1] * n.y + m[2][1] * n.z,
+			m[0][2] * n.x + m[1][2] * n.y + m[2][2] * n.z);
+	}
+
+	// (*this) * rhs, i.e. rhs is applied first.
+	Matrix34 operator*(const Matrix34& rhs) const
+	{
+		Matrix34 result;
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				result.m[i][j] = m[i][0] * rhs.m[0][j] + m[i][1] * rhs.m[1][j] + m[i][2] * rhs.m[2][j];
+			}
+			result.m[i][3] += m[i][3];
+		}
+		return result;
+	}
+
+	double getDeterminant() const
+	{
+		return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+			- m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+			+ m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+	}
+
+	// True when the linear part can not be inverted reliably. The determinant
+	// is compared against the product of the row lengths (its upper bound), so
+	// a uniform 0.001 scale is as invertible as a uniform 1000 scale.
+	bool isSingular() const
+	{
+		double det = getDeterminant();
+		if (!std::isfinite(det) || det == 0.0)
+			return true;
+
+		double bound = 1.0;
+		for (int i = 0; i < 3; i++)
+			bound *= Vector3(m[i][0], m[i][1], m[i][2]).getLength();
+		return fabs(det) <= singular_tolerance * bound;
+	}
+
+	// The matrix must not be singular; check isSingular() first.
+	Matrix34 getInverse() const
+	{
+		assert(!isSingular());
+		double inv_det = 1.0 / getDeterminant();
+
+		Matrix34 result(
+			(m[1][1] * m[2][2] - m[1][2] * m[2][1]) * inv_det,
+			(m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inv_det,
+			(m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv_det,
+			0,
+			(m[1][2] * m[2][0] - m[1][0] * m[2][2]) * inv_det,
+			(m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv_det,
+			(m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inv_det,
+			0,
+			(m[1][0] * m[2][1] - m[1][1] * m[2][0]) * inv_det,
+			(m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inv_det,
+			(m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv_det,
+			0);
+
+		Vector3 t = result.transformVector(Vector3(m[0][3], m[1][3], m[2][3]));
+		result.m[0][3] = -t.x;
+		result.m[1][3] = -t.y;
+		result.m[2][3] = -t.z;
+		return result;
+	}
+
+	Vector3 getTranslation() const { return Vector3(m[0][3], m[1][3], m[2][3]); }
+
+	bool isIdentity() const { return *this == Matrix34(); }
+
+	bool operator==(const Matrix34& rhs) const
+	{
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 4; j++)
+				if (!equal(m[i][j], rhs.m[i][j]))
+					return false;
+		return true;
+	}
+
+public:
+	double m[3][4];
+
+private:
+	static constexpr double singular_tolerance = 1e-12;
+};
+
+#endif // !MATRIX34_H
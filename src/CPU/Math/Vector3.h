@@ -63,6 +63,11 @@ public:
 	inline bool operator==(const Vector3& rhs) const { return (equal(x, rhs.x) && equal(y, rhs.y) && equal(z, rhs.z)); }
 	inline bool operator!=(const Vector3& rhs) const { return (!equal(x, rhs.x) || !equal(y, rhs.y) || !equal(z, rhs.z)); }
 
+	inline double operator[](int index) const
+	{
+		return index == 0 ? x : (index == 1 ? y : z);
+	}
+
 	double& operator[](int index) 
 	{
 		try
@@ -0,0 +1,265 @@
+#include "Mesh.h"
+#include "Stats.h"
+
+#include <algorithm>
+
+#include <tbb/parallel_for.h>
+
+TriangleMesh::TriangleMesh(shared_ptr<const MeshData> mesh, shared_ptr<Material> m)
+	: m_mesh(mesh), m_mat_ptr(m)
+{
+	const size_t count = m_mesh->getTriangleCount();
+	if (count == 0)
+		return;
+
+	Stats::ScopedTimer timer(Stats::BVHBuild);
+
+	const std::vector<uint32_t>& indices = m_mesh->position_indices;
+	const std::vector<float>& positions = m_mesh->positions;
+
+	std::vector<float> centroids(count * 3);
+	m_triangles.resize(count);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, count), [&](const tbb::blocked_range<size_t>& r)
+	{
+		for (size_t i = r.begin(); i != r.end(); i++)
+		{
+			m_triangles[i] = static_cast<uint32_t>(i);
+			for (int a = 0; a < 3; a++)
+			{
+				centroids[3 * i + a] = (positions[3 * indices[3 * i + 0] + a]
+					+ positions[3 * indices[3 * i + 1] + a]
+					+ positions[3 * indices[3 * i + 2] + a]) * (1.0f / 3.0f);
+			}
+		}
+	});
+
+	m_nodes.reserve(2 * count / max_leaf_size + 1);
+	build(centroids, 0, static_cast<uint32_t>(count));
+}
+
+uint32_t TriangleMesh::build(std::vector<float>& centroids, uint32_t begin, uint32_t end)
+{
+	const std::vector<uint32_t>& indices = m_mesh->position_indices;
+	const std::vector<float>& positions = m_mesh->positions;
+
+	uint32_t index = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.emplace_back();
+
+	Node node;
+	float cmin[3], cmax[3];
+	for (int a = 0; a < 3; a++)
+	{
+		node.min[a] = cmin[a] = std::numeric_limits<float>::infinity();
+		node.max[a] = cmax[a] = -std::numeric_limits<float>::infinity();
+	}
+
+	for (uint32_t i = begin; i < end; i++)
+	{
+		uint32_t tri = m_triangles[i];
+		for (int a = 0; a < 3; a++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				float p = positions[3 * indices[3 * tri + c] + a];
+				node.min[a] = std::min(node.min[a], p);
+				node.max[a] = std::max(node.max[a], p);
+			}
+			cmin[a] = std::min(cmin[a], centroids[3 * tri + a]);
+			cmax[a] = std::max(cmax[a], centroids[3 * tri + a]);
+		}
+	}
+
+	uint32_t count = end - begin;
+	if (count <= max_leaf_size)
+	{
+		node.offset = begin;
+		node.count = static_cast<uint16_t>(count);
+		node.axis = 0;
+		m_nodes[index] = node;
+		return index;
+	}
+
+	// Median split along the longest centroid extent.
+	int axis = 0;
+	if (cmax[1] - cmin[1] > cmax[axis] - cmin[axis]) axis = 1;
+	if (cmax[2] - cmin[2] > cmax[axis] - cmin[axis]) axis = 2;
+
+	uint32_t mid = begin + count / 2;
+	std::nth_element(m_triangles.begin() + begin, m_triangles.begin() + mid, m_triangles.begin() + end,
+		[&](uint32_t a, uint32_t b) { return centroids[3 * a + axis] < centroids[3 * b + axis]; });
+
+	build(centroids, begin, mid);	// left child is always index + 1
+	node.offset = build(centroids, mid, end);
+	node.count = 0;
+	node.axis = static_cast<uint16_t>(axis);
+	m_nodes[index] = node;
+
+	return index;
+}
+
+inline bool hitNodeBox(const float* bmin, const float* bmax, const double* origin, const double* inv_dir, double tmin, double tmax)
+{
+	for (int a = 0; a < 3; a++)
+	{
+		double t0 = (bmin[a] - origin[a]) * inv_dir[a];
+		double t1 = (bmax[a] - origin[a]) * inv_dir[a];
+		if (inv_dir[a] < 0.0)
+			std::swap(t0, t1);
+		tmin = t0 > tmin ? t0 : tmin;
+		tmax = t1 < tmax ? t1 : tmax;
+		if (tmax < tmin)
+			return false;
+	}
+	return true;
+}
+
+bool TriangleMesh::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const
+{
+	if (m_nodes.empty())
+		return false;
+
+	const Vector3 org = r.getOrigin();
+	const Vector3 dir = r.getDirection();
+	const double origin[3] = { org.x, org.y, org.z };
+	const double inv_dir[3] = { 1.0 / dir.x, 1.0 / dir.y, 1.0 / dir.z };
+
+	uint32_t stack[64];
+	int stack_size = 0;
+	uint32_t current = 0;
+	double closest_so_far = tmax;
+	bool hit_anything = false;
+
+	while (true)
+	{
+		const Node& node = m_nodes[current];
+		RT_STAT_INC(BVHNodesVisited);
+		if (hitNodeBox(node.min, node.max, origin, inv_dir, tmin, closest_so_far))
+		{
+			if (node.count > 0)
+			{
+				for (uint32_t i = 0; i < node.count; i++)
+				{
+					if (hitTriangle(m_triangles[node.offset + i], r, tmin, closest_so_far, rec))
+					{
+						hit_anything = true;
+						closest_so_far = rec.t;
+					}
+				}
+			}
+			else
+			{
+				// Visit the near child first.
+				if (inv_dir[node.axis] < 0.0)
+				{
+					stack[stack_size++] = current + 1;
+					current = node.offset;
+				}
+				else
+				{
+					stack[stack_size++] = node.offset;
+					current = current + 1;
+				}
+				RT_STAT_STACK_DEPTH(stack_size);
+				continue;
+			}
+		}
+
+		if (stack_size == 0)
+			break;
+		current = stack[--stack_size];
+	}
+
+	return hit_anything;
+}
+
+bool TriangleMesh::hitTriangle(uint32_t tri, const Ray& r, double tmin, double tmax, HitRecord& rec) const
+{
+	RT_STAT_INC(PrimitiveTests);
+
+	const MeshData& mesh = *m_mesh;
+	const uint32_t* idx = &mesh.position_indices[3 * tri];
+
+	Point3 p0 = mesh.getPosition(idx[0]);
+	Vector3 e1 = mesh.getPosition(idx[1]) - p0;
+	Vector3 e2 = mesh.getPosition(idx[2]) - p0;
+
+	// Moller-Trumbore
+	Vector3 pvec = r.getDirection().crossProduct(e2);
+	double det = e1.dotProduct(pvec);
+	if (fabs(det) < 1e-12)
+		return false;
+
+	double inv_det = 1.0 / det;
+	Vector3 tvec = r.getOrigin() - p0;
+	double b1 = tvec.dotProduct(pvec) * inv_det;
+	if (b1 < 0.0 || b1 > 1.0)
+		return false;
+
+	Vector3 qvec = tvec.crossProduct(e1);
+	double b2 = r.getDirection().dotProduct(qvec) * inv_det;
+	if (b2 < 0.0 || b1 + b2 > 1.0)
+		return false;
+
+	double t = e2.dotProduct(qvec) * inv_det;
+	if (t <= tmin || t >= tmax)
+		return false;
+
+	double b0 = 1.0 - b1 - b2;
+
+	Vector3 outward_normal;
+	if (!mesh.normal_indices.empty())
+	{
+		const uint32_t* nidx = &mesh.normal_indices[3 * tri];
+		const float* n0 = &mesh.normals[3 * nidx[0]];
+		const float* n1 = &mesh.normals[3 * nidx[1]];
+		const float* n2 = &mesh.normals[3 * nidx[2]];
+		outward_normal = Vector3(
+			b0 * n0[0] + b1 * n1[0] + b2 * n2[0],
+			b0 * n0[1] + b1 * n1[1] + b2 * n2[1],
+			b0 * n0[2] + b1 * n1[2] + b2 * n2[2]).getNormalied();
+	}
+	else
+	{
+		outward_normal = e1.crossProduct(e2).getNormalied();
+	}
+
+	if (!mesh.texcoord_indices.empty())
+	{
+		const uint32_t* tidx = &mesh.texcoord_indices[3 * tri];
+		const float* t0 = &mesh.texcoords[2 * tidx[0]];
+		const float* t1 = &mesh.texcoords[2 * tidx[1]];
+		const float* t2 = &mesh.texcoords[2 * tidx[2]];
+		rec.u = b0 * t0[0] + b1 * t1[0] + b2 * t2[0];
+		rec.v = b0 * t0[1] + b1 * t1[1] + b2 * t2[1];
+
+		double uv_area = fabs((t1[0] - t0[0]) * (t2[1] - t0[1]) - (t2[0] - t0[0]) * (t1[1] - t0[1]));
+		rec.uv_density = sqrt(uv_area / e1.crossProduct(e2).getLength());
+	}
+	else
+	{
+		rec.u = b1;
+		rec.v = b2;
+		rec.uv_density = sqrt(1.0 / e1.crossProduct(e2).getLength());
+	}
+
+	rec.t = t;
+	rec.position = r.pointAt(t);
+	rec.setFaceNormal(r, outward_normal);
+	rec.mat_ptr = m_mat_ptr;
+
+	RT_STAT_INC(TriangleHits);
+	return true;
+}
+
+bool TriangleMesh::boundingBox(const double t0, const double t1, AABB& outputBox) const
+{
+	if (m_nodes.empty())
+		return false;
+
+	// Pad like the rects do, so flat meshes still have a volume.
+	const Node& root = m_nodes[0];
+	outputBox = AABB(
+		Point3(root.min[0] - 0.0001, root.min[1] - 0.0001, root.min[2] - 0.0001),
+		Point3(root.max[0] + 0.0001, root.max[1] + 0.0001, root.max[2] + 0.0001));
+	return true;
+}
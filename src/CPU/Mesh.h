@@ -0,0 +1,63 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <cstdint>
+
+#include "Hittable.h"
+
+// Flat triangle data as produced by the importers. Corner attributes are
+// indexed separately (like OBJ), so normals and texcoords may be empty.
+struct MeshData
+{
+	std::vector<float> positions;				// xyz per vertex
+	std::vector<float> normals;					// xyz per normal
+	std::vector<float> texcoords;				// uv per texcoord
+	std::vector<uint32_t> position_indices;		// 3 per triangle
+	std::vector<uint32_t> normal_indices;		// 3 per triangle, or empty
+	std::vector<uint32_t> texcoord_indices;		// 3 per triangle, or empty
+
+	size_t getTriangleCount() const { return position_indices.size() / 3; }
+	size_t getVertexCount() const { return positions.size() / 3; }
+
+	Point3 getPosition(uint32_t i) const
+	{
+		return Point3(positions[3 * i + 0], positions[3 * i + 1], positions[3 * i + 2]);
+	}
+};
+
+// One Hittable for a whole mesh. Triangles live in the shared MeshData and are
+// traversed through an internal flat BVH, so there is no per-triangle object.
+class TriangleMesh : public Hittable
+{
+public:
+	TriangleMesh(shared_ptr<const MeshData> mesh, shared_ptr<Material> m);
+
+	virtual bool hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const override;
+	virtual bool boundingBox(const double t0, const double t1, AABB& outputBox) const override;
+
+	size_t getTriangleCount() const { return m_mesh->getTriangleCount(); }
+	size_t getNodeCount() const { return m_nodes.size(); }
+
+private:
+	static const int max_leaf_size = 4;
+
+	struct Node
+	{
+		float min[3];
+		float max[3];
+		uint32_t offset;	// first triangle for a leaf, right child otherwise
+		uint16_t count;		// triangle count, 0 for inner nodes
+		uint16_t axis;		// split axis for inner nodes
+	};
+
+	uint32_t build(std::vector<float>& centroids, uint32_t begin, uint32_t end);
+	bool hitTriangle(uint32_t tri, const Ray& r, double tmin, double tmax, HitRecord& rec) const;
+
+private:
+	shared_ptr<const MeshData> m_mesh;
+	shared_ptr<Material> m_mat_ptr;
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_triangles;	// triangle ids in BVH leaf order
+};
+
+#endif // !MESH_H
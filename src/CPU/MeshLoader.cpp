@@ -0,0 +1,743 @@
+#include "MeshLoader.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <tbb/parallel_for.h>
+
+namespace
+{
+	// Target size of one parse task. Chunks are cut at line boundaries.
+	const size_t chunk_bytes = 4 << 20;
+
+	// OBJ indices that are relative (negative) can only be resolved once the
+	// number of elements in all previous chunks is known.
+	const uint32_t relative_flag = 0x80000000u;
+	const uint32_t missing_index = 0xffffffffu;
+
+	inline bool isBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline const char* skipBlanks(const char* p, const char* end)
+	{
+		while (p < end && isBlank(*p)) p++;
+		return p;
+	}
+
+	inline bool parseFloat(const char*& p, const char* end, float& value)
+	{
+		p = skipBlanks(p, end);
+		if (p < end && *p == '+') p++;
+		auto result = std::from_chars(p, end, value);
+		if (result.ec != std::errc())
+			return false;
+		p = result.ptr;
+		return true;
+	}
+
+	inline bool parseInt(const char*& p, const char* end, long long& value)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+			negative = (*p++ == '-');
+		if (p >= end || *p < '0' || *p > '9')
+			return false;
+
+		// Saturates instead of overflowing; callers range check the value.
+		const long long limit = (LLONG_MAX - 9) / 10;
+		long long v = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			v = v <= limit ? v * 10 + (*p - '0') : LLONG_MAX;
+			p++;
+		}
+		value = negative ? -v : v;
+		return true;
+	}
+
+	// Converts a 1-based or negative OBJ index into a 0-based one, flagging
+	// negative indices as relative to the chunk-local element count. Index 0
+	// is not valid OBJ and fails, as do indices that do not fit in 31 bits.
+	// A relative index may reach back before the chunk; that is resolved
+	// and range checked after the merge.
+	inline bool resolveIndex(long long index, size_t local_count, uint32_t& resolved)
+	{
+		if (index == 0 || index > 0x7fffffff || index < -0x7fffffff)
+			return false;
+		if (index < 0 && static_cast<long long>(local_count) + index < -0x40000000)
+			return false;	// does not fit the 31-bit signed form
+		if (index > 0)
+			resolved = static_cast<uint32_t>(index - 1);
+		else // Kept as a 31-bit signed value, since it may point into an earlier chunk.
+			resolved = (static_cast<uint32_t>(static_cast<long long>(local_count) + index) & ~relative_flag) | relative_flag;
+		return true;
+	}
+
+	bool indicesInRange(const std::vector<uint32_t>& indices, size_t count)
+	{
+		for (uint32_t index : indices)
+		{
+			if (index >= count)
+				return false;
+		}
+		return true;
+	}
+
+	struct ObjChunk
+	{
+		std::vector<float> positions;
+		std::vector<float> normals;
+		std::vector<float> texcoords;
+		std::vector<uint32_t> position_indices;
+		std::vector<uint32_t> normal_indices;
+		std::vector<uint32_t> texcoord_indices;
+		bool missing_normals = false;
+		bool missing_texcoords = false;
+		bool failed = false;
+	};
+
+	void parseObjChunk(const char* p, const char* end, ObjChunk& chunk)
+	{
+		struct Corner { uint32_t v, vt, vn; };
+		std::vector<Corner> polygon;
+
+		while (p < end)
+		{
+			const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (line_end == nullptr)
+				line_end = end;
+
+			p = skipBlanks(p, line_end);
+			if (line_end - p >= 2 && p[0] == 'v')
+			{
+				float x, y, z;
+				if (isBlank(p[1]))
+				{
+					p += 1;
+					if (!parseFloat(p, line_end, x) || !parseFloat(p, line_end, y) || !parseFloat(p, line_end, z))
+						chunk.failed = true;
+					chunk.positions.insert(chunk.positions.end(), { x, y, z });
+				}
+				else if (p[1] == 't' && line_end - p >= 3 && isBlank(p[2]))
+				{
+					p += 2;
+					if (!parseFloat(p, line_end, x))
+						chunk.failed = true;
+					if (!parseFloat(p, line_end, y))
+						y = 0.0f;
+					chunk.texcoords.insert(chunk.texcoords.end(), { x, y });
+				}
+				else if (p[1] == 'n' && line_end - p >= 3 && isBlank(p[2]))
+				{
+					p += 2;
+					if (!parseFloat(p, line_end, x) || !parseFloat(p, line_end, y) || !parseFloat(p, line_end, z))
+						chunk.failed = true;
+					chunk.normals.insert(chunk.normals.end(), { x, y, z });
+				}
+			}
+			else if (line_end - p >= 2 && p[0] == 'f' && isBlank(p[1]))
+			{
+				p += 1;
+				polygon.clear();
+				while (true)
+				{
+					p = skipBlanks(p, line_end);
+					long long index;
+					if (!parseInt(p, line_end, index))
+						break;
+
+					Corner corner = { missing_index, missing_index, missing_index };
+					if (!resolveIndex(index, chunk.positions.size() / 3, corner.v))
+						chunk.failed = true;
+					if (p < line_end && *p == '/')
+					{
+						p++;
+						if (parseInt(p, line_end, index) && !resolveIndex(index, chunk.texcoords.size() / 2, corner.vt))
+							chunk.failed = true;
+						if (p < line_end && *p == '/')
+						{
+							p++;
+							if (parseInt(p, line_end, index) && !resolveIndex(index, chunk.normals.size() / 3, corner.vn))
+								chunk.failed = true;
+						}
+					}
+					polygon.push_back(corner);
+				}
+
+				// Fan triangulation
+				for (size_t i = 2; i < polygon.size(); i++)
+				{
+					const Corner* corners[3] = { &polygon[0], &polygon[i - 1], &polygon[i] };
+					for (const Corner* c : corners)
+					{
+						chunk.position_indices.push_back(c->v);
+						chunk.texcoord_indices.push_back(c->vt);
+						chunk.normal_indices.push_back(c->vn);
+						chunk.missing_texcoords |= (c->vt == missing_index);
+						chunk.missing_normals |= (c->vn == missing_index);
+					}
+				}
+			}
+
+			p = line_end + 1;
+		}
+	}
+
+	// Copies chunk-local indices into the merged array, rebasing relative ones.
+	void copyIndices(const std::vector<uint32_t>& src, uint32_t* dst, uint32_t base)
+	{
+		for (size_t i = 0; i < src.size(); i++)
+		{
+			if (src[i] & relative_flag)
+				dst[i] = base + static_cast<uint32_t>(static_cast<int32_t>(src[i] << 1) >> 1);
+			else
+				dst[i] = src[i];
+		}
+	}
+}
+
+shared_ptr<MeshData> loadOBJ(const char* filename)
+{
+	MappedFile file(filename);
+	if (!file.isOpen())
+		return nullptr;
+
+	const char* data = file.getData();
+	const char* end = data + file.getSize();
+
+	// Split at line boundaries.
+	std::vector<const char*> bounds = { data };
+	while (end - bounds.back() > static_cast<ptrdiff_t>(chunk_bytes))
+	{
+		const char* cut = bounds.back() + chunk_bytes;
+		cut = static_cast<const char*>(memchr(cut, '\n', end - cut));
+		if (cut == nullptr)
+			break;
+		bounds.push_back(cut + 1);
+	}
+	bounds.push_back(end);
+
+	const size_t chunk_count = bounds.size() - 1;
+	std::vector<ObjChunk> chunks(chunk_count);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, chunk_count, 1), [&](const tbb::blocked_range<size_t>& r)
+	{
+		for (size_t i = r.begin(); i != r.end(); i++)
+			parseObjChunk(bounds[i], bounds[i + 1], chunks[i]);
+	});
+
+	// Prefix sums give every chunk its offset into the merged arrays.
+	struct Offsets { size_t v, vt, vn, idx; };
+	std::vector<Offsets> offsets(chunk_count + 1, Offsets{ 0, 0, 0, 0 });
+	bool missing_texcoords = false;
+	bool missing_normals = false;
+	for (size_t i = 0; i < chunk_count; i++)
+	{
+		if (chunks[i].failed)
+		{
+			std::cerr << "Malformed vertex or face data in OBJ->" << filename << std::endl;
+			return nullptr;
+		}
+		offsets[i + 1].v = offsets[i].v + chunks[i].positions.size();
+		offsets[i + 1].vt = offsets[i].vt + chunks[i].texcoords.size();
+		offsets[i + 1].vn = offsets[i].vn + chunks[i].normals.size();
+		offsets[i + 1].idx = offsets[i].idx + chunks[i].position_indices.size();
+		missing_texcoords |= chunks[i].missing_texcoords;
+		missing_normals |= chunks[i].missing_normals;
+	}
+
+	auto mesh = make_shared<MeshData>();
+	const Offsets& total = offsets[chunk_count];
+	mesh->positions.resize(total.v);
+	mesh->texcoords.resize(total.vt);
+	mesh->normals.resize(total.vn);
+	mesh->position_indices.resize(total.idx);
+	if (!missing_texcoords) mesh->texcoord_indices.resize(total.idx);
+	if (!missing_normals) mesh->normal_indices.resize(total.idx);
+
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, chunk_count, 1), [&](const tbb::blocked_range<size_t>& r)
+	{
+		for (size_t i = r.begin(); i != r.end(); i++)
+		{
+			ObjChunk& chunk = chunks[i];
+			const Offsets& o = offsets[i];
+			std::copy(chunk.positions.begin(), chunk.positions.end(), mesh->positions.begin() + o.v);
+			std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), mesh->texcoords.begin() + o.vt);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), mesh->normals.begin() + o.vn);
+
+			copyIndices(chunk.position_indices, mesh->position_indices.data() + o.idx, static_cast<uint32_t>(o.v / 3));
+			if (!missing_texcoords)
+				copyIndices(chunk.texcoord_indices, mesh->texcoord_indices.data() + o.idx, static_cast<uint32_t>(o.vt / 2));
+			if (!missing_normals)
+				copyIndices(chunk.normal_indices, mesh->normal_indices.data() + o.idx, static_cast<uint32_t>(o.vn / 3));
+
+			chunk = ObjChunk();
+		}
+	});
+
+	// Rendering indexes the attribute arrays directly, so all three index
+	// arrays must stay inside theirs.
+	if (!indicesInRange(mesh->position_indices, mesh->getVertexCount()) ||
+		!indicesInRange(mesh->texcoord_indices, mesh->texcoords.size() / 2) ||
+		!indicesInRange(mesh->normal_indices, mesh->normals.size() / 3))
+	{
+		std::cerr << "Vertex index out of range in OBJ->" << filename << std::endl;
+		return nullptr;
+	}
+
+	return mesh;
+}
+
+namespace
+{
+	enum class PlyType { Invalid, Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+	PlyType parsePlyType(const std::string& name)
+	{
+		if (name == "char" || name == "int8") return PlyType::Int8;
+		if (name == "uchar" || name == "uint8") return PlyType::UInt8;
+		if (name == "short" || name == "int16") return PlyType::Int16;
+		if (name == "ushort" || name == "uint16") return PlyType::UInt16;
+		if (name == "int" || name == "int32") return PlyType::Int32;
+		if (name == "uint" || name == "uint32") return PlyType::UInt32;
+		if (name == "float" || name == "float32") return PlyType::Float32;
+		if (name == "double" || name == "float64") return PlyType::Float64;
+		return PlyType::Invalid;
+	}
+
+	size_t plyTypeSize(PlyType type)
+	{
+		switch (type)
+		{
+		case PlyType::Int8: case PlyType::UInt8: return 1;
+		case PlyType::Int16: case PlyType::UInt16: return 2;
+		case PlyType::Int32: case PlyType::UInt32: case PlyType::Float32: return 4;
+		case PlyType::Float64: return 8;
+		default: return 0;
+		}
+	}
+
+	template<typename T>
+	inline T readRaw(const char* p, bool swap)
+	{
+		char bytes[sizeof(T)];
+		memcpy(bytes, p, sizeof(T));
+		if (swap)
+			std::reverse(bytes, bytes + sizeof(T));
+		T value;
+		memcpy(&value, bytes, sizeof(T));
+		return value;
+	}
+
+	inline double readPlyScalar(const char* p, PlyType type, bool swap)
+	{
+		switch (type)
+		{
+		case PlyType::Int8: return static_cast<int8_t>(*p);
+		case PlyType::UInt8: return static_cast<uint8_t>(*p);
+		case PlyType::Int16: return readRaw<int16_t>(p, swap);
+		case PlyType::UInt16: return readRaw<uint16_t>(p, swap);
+		case PlyType::Int32: return readRaw<int32_t>(p, swap);
+		case PlyType::UInt32: return readRaw<uint32_t>(p, swap);
+		case PlyType::Float32: return readRaw<float>(p, swap);
+		case PlyType::Float64: return readRaw<double>(p, swap);
+		default: return 0.0;
+		}
+	}
+
+	inline bool isPlyInteger(PlyType type)
+	{
+		return type != PlyType::Invalid && type != PlyType::Float32 && type != PlyType::Float64;
+	}
+
+	// Reads an integer list index. Negative ones come back as UINT32_MAX,
+	// which no mesh can reach, so the range check after decoding rejects them.
+	inline uint32_t readPlyIndex(const char* p, PlyType type, bool swap)
+	{
+		int64_t index;
+		switch (type)
+		{
+		case PlyType::Int8: index = static_cast<int8_t>(*p); break;
+		case PlyType::UInt8: index = static_cast<uint8_t>(*p); break;
+		case PlyType::Int16: index = readRaw<int16_t>(p, swap); break;
+		case PlyType::UInt16: index = readRaw<uint16_t>(p, swap); break;
+		case PlyType::Int32: index = readRaw<int32_t>(p, swap); break;
+		case PlyType::UInt32: index = readRaw<uint32_t>(p, swap); break;
+		default: index = -1; break;
+		}
+		return index < 0 ? UINT32_MAX : static_cast<uint32_t>(index);
+	}
+
+	struct PlyProperty
+	{
+		std::string name;
+		PlyType type = PlyType::Invalid;
+		PlyType count_type = PlyType::Invalid;	// list properties only
+		bool is_list = false;
+	};
+
+	struct PlyElement
+	{
+		std::string name;
+		size_t count = 0;
+		std::vector<PlyProperty> properties;
+
+		// Byte size of one element, 0 if it contains lists.
+		size_t getStride() const
+		{
+			size_t stride = 0;
+			for (const auto& prop : properties)
+			{
+				if (prop.is_list) return 0;
+				stride += plyTypeSize(prop.type);
+			}
+			return stride;
+		}
+
+		// Byte offset of a scalar property, or -1 if absent or preceded by a list.
+		ptrdiff_t getOffset(const char* prop_name) const
+		{
+			size_t offset = 0;
+			for (const auto& prop : properties)
+			{
+				if (prop.name == prop_name)
+					return prop.is_list ? -1 : static_cast<ptrdiff_t>(offset);
+				if (prop.is_list) return -1;
+				offset += plyTypeSize(prop.type);
+			}
+			return -1;
+		}
+
+		const PlyProperty* find(const char* prop_name) const
+		{
+			for (const auto& prop : properties)
+				if (prop.name == prop_name) return &prop;
+			return nullptr;
+		}
+	};
+
+	bool isHostLittleEndian()
+	{
+		const uint16_t probe = 1;
+		return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+	}
+}
+
+shared_ptr<MeshData> loadPLY(const char* filename)
+{
+	MappedFile file(filename);
+	if (!file.isOpen())
+		return nullptr;
+
+	const char* data = file.getData();
+	const char* end = data + file.getSize();
+
+	// Header
+	const char* header_end = nullptr;
+	{
+		const char marker[] = "end_header";
+		for (const char* p = data; p + sizeof(marker) - 1 <= end; )
+		{
+			const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (line_end == nullptr)
+				break;
+			if (strncmp(p, marker, sizeof(marker) - 1) == 0)
+			{
+				header_end = line_end + 1;
+				break;
+			}
+			p = line_end + 1;
+		}
+	}
+
+	if (header_end == nullptr || strncmp(data, "ply", 3) != 0)
+	{
+		std::cerr << "Invalid PLY header->" << filename << std::endl;
+		return nullptr;
+	}
+
+	bool binary = false;
+	bool little_endian = true;
+	std::vector<PlyElement> elements;
+	{
+		const char* p = data;
+		while (p < header_end)
+		{
+			const char* line_end = static_cast<const char*>(memchr(p, '\n', header_end - p));
+			std::string line(p, line_end);
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			p = line_end + 1;
+
+			char word[5][64] = {};
+			int words = sscanf(line.c_str(), "%63s %63s %63s %63s %63s", word[0], word[1], word[2], word[3], word[4]);
+			if (words <= 0)
+				continue;
+
+			if (strcmp(word[0], "format") == 0 && words >= 2)
+			{
+				binary = strcmp(word[1], "ascii") != 0;
+				little_endian = strcmp(word[1], "binary_little_endian") == 0;
+			}
+			else if (strcmp(word[0], "element") == 0 && words >= 3)
+			{
+				PlyElement element;
+				element.name = word[1];
+				try
+				{
+					element.count = std::stoull(word[2]);
+				}
+				catch (const std::exception&)
+				{
+					std::cerr << "Invalid PLY element count->" << filename << std::endl;
+					return nullptr;
+				}
+				elements.push_back(element);
+			}
+			else if (strcmp(word[0], "property") == 0 && !elements.empty())
+			{
+				PlyProperty prop;
+				if (strcmp(word[1], "list") == 0 && words >= 5)
+				{
+					prop.is_list = true;
+					prop.count_type = parsePlyType(word[2]);
+					prop.type = parsePlyType(word[3]);
+					prop.name = word[4];
+				}
+				else if (words >= 3)
+				{
+					prop.type = parsePlyType(word[1]);
+					prop.name = word[2];
+				}
+
+				// Lists hold counts and indices, so they must be integers.
+				if (prop.type == PlyType::Invalid || (prop.is_list && (!isPlyInteger(prop.count_type) || !isPlyInteger(prop.type))))
+				{
+					std::cerr << "Unsupported PLY property \"" << line << "\"->" << filename << std::endl;
+					return nullptr;
+				}
+				elements.back().properties.push_back(prop);
+			}
+		}
+	}
+
+	if (!binary)
+	{
+		std::cerr << "Only binary PLY is supported->" << filename << std::endl;
+		return nullptr;
+	}
+
+	const bool swap = little_endian != isHostLittleEndian();
+	auto mesh = make_shared<MeshData>();
+
+	const char* p = header_end;
+	for (const PlyElement& element : elements)
+	{
+		if (element.name == "vertex")
+		{
+			const size_t stride = element.getStride();
+			if (stride == 0 || element.count > static_cast<size_t>(end - p) / stride)
+			{
+				std::cerr << "Unsupported or truncated PLY vertex data->" << filename << std::endl;
+				return nullptr;
+			}
+
+			const ptrdiff_t pos[3] = { element.getOffset("x"), element.getOffset("y"), element.getOffset("z") };
+			const ptrdiff_t nor[3] = { element.getOffset("nx"), element.getOffset("ny"), element.getOffset("nz") };
+			const char* uv_names[2] = { "u", "v" };
+			if (element.getOffset("u") < 0) { uv_names[0] = "s"; uv_names[1] = "t"; }
+			if (element.getOffset("s") < 0 && element.getOffset("u") < 0) { uv_names[0] = "texture_u"; uv_names[1] = "texture_v"; }
+			const ptrdiff_t uv[2] = { element.getOffset(uv_names[0]), element.getOffset(uv_names[1]) };
+
+			if (pos[0] < 0 || pos[1] < 0 || pos[2] < 0)
+			{
+				std::cerr << "PLY vertices have no position->" << filename << std::endl;
+				return nullptr;
+			}
+
+			const bool has_normals = nor[0] >= 0 && nor[1] >= 0 && nor[2] >= 0;
+			const bool has_texcoords = uv[0] >= 0 && uv[1] >= 0;
+			const PlyType pos_type[3] = { element.find("x")->type, element.find("y")->type, element.find("z")->type };
+			const PlyType nor_type[3] = {
+				has_normals ? element.find("nx")->type : PlyType::Invalid,
+				has_normals ? element.find("ny")->type : PlyType::Invalid,
+				has_normals ? element.find("nz")->type : PlyType::Invalid };
+			const PlyType uv_type[2] = {
+				has_texcoords ? element.find(uv_names[0])->type : PlyType::Invalid,
+				has_texcoords ? element.find(uv_names[1])->type : PlyType::Invalid };
+
+			mesh->positions.resize(3 * element.count);
+			if (has_normals) mesh->normals.resize(3 * element.count);
+			if (has_texcoords) mesh->texcoords.resize(2 * element.count);
+
+			const char* base = p;
+			tbb::parallel_for(tbb::blocked_range<size_t>(0, element.count), [&](const tbb::blocked_range<size_t>& r)
+			{
+				for (size_t i = r.begin(); i != r.end(); i++)
+				{
+					const char* v = base + i * stride;
+					for (int a = 0; a < 3; a++)
+					{
+						mesh->positions[3 * i + a] = static_cast<float>(readPlyScalar(v + pos[a], pos_type[a], swap));
+						if (has_normals)
+							mesh->normals[3 * i + a] = static_cast<float>(readPlyScalar(v + nor[a], nor_type[a], swap));
+					}
+					if (has_texcoords)
+					{
+						mesh->texcoords[2 * i + 0] = static_cast<float>(readPlyScalar(v + uv[0], uv_type[0], swap));
+						mesh->texcoords[2 * i + 1] = static_cast<float>(readPlyScalar(v + uv[1], uv_type[1], swap));
+					}
+				}
+			});
+
+			p += stride * element.count;
+		}
+		else if (element.name == "face")
+		{
+			// A face is [scalars...] list [scalars...]; only one list is allowed.
+			size_t before = 0, after = 0;
+			const PlyProperty* list = nullptr;
+			for (const auto& prop : element.properties)
+			{
+				if (prop.is_list)
+				{
+					if (list != nullptr || (prop.name != "vertex_indices" && prop.name != "vertex_index"))
+					{
+						std::cerr << "Unsupported PLY face layout->" << filename << std::endl;
+						return nullptr;
+					}
+					list = &prop;
+				}
+				else
+				{
+					(list ? after : before) += plyTypeSize(prop.type);
+				}
+			}
+
+			if (list == nullptr)
+			{
+				std::cerr << "PLY faces have no vertex indices->" << filename << std::endl;
+				return nullptr;
+			}
+
+			// Faces are variable length, so find every face start serially
+			// (one count read per face) and decode them in parallel.
+			const size_t count_size = plyTypeSize(list->count_type);
+			const size_t index_size = plyTypeSize(list->type);
+			const size_t min_face_size = before + count_size + after;
+			if (element.count > static_cast<size_t>(end - p) / min_face_size)
+			{
+				std::cerr << "Truncated PLY face data->" << filename << std::endl;
+				return nullptr;
+			}
+			std::vector<size_t> face_offsets(element.count + 1);
+			std::vector<size_t> tri_offsets(element.count + 1);
+			face_offsets[0] = 0;
+			tri_offsets[0] = 0;
+			for (size_t i = 0; i < element.count; i++)
+			{
+				const char* f = p + face_offsets[i];
+				if (f + min_face_size > end)
+				{
+					std::cerr << "Truncated PLY face data->" << filename << std::endl;
+					return nullptr;
+				}
+				// Read the count signed so a negative char/short count is
+				// rejected rather than wrapping to a huge size_t.
+				const double count = readPlyScalar(f + before, list->count_type, swap);
+				const size_t remaining = static_cast<size_t>(end - f) - min_face_size;
+				if (!(count >= 0.0) || count != std::floor(count) || count > static_cast<double>(remaining / index_size))
+				{
+					std::cerr << "Invalid PLY face vertex count->" << filename << std::endl;
+					return nullptr;
+				}
+				size_t n = static_cast<size_t>(count);
+				face_offsets[i + 1] = face_offsets[i] + min_face_size + n * index_size;
+				tri_offsets[i + 1] = tri_offsets[i] + (n >= 3 ? n - 2 : 0);
+			}
+
+			if (p + face_offsets[element.count] > end)
+			{
+				std::cerr << "Truncated PLY face data->" << filename << std::endl;
+				return nullptr;
+			}
+
+			mesh->position_indices.resize(3 * tri_offsets[element.count]);
+			const char* base = p;
+			const PlyType index_type = list->type;
+			tbb::parallel_for(tbb::blocked_range<size_t>(0, element.count), [&](const tbb::blocked_range<size_t>& r)
+			{
+				for (size_t i = r.begin(); i != r.end(); i++)
+				{
+					const char* f = base + face_offsets[i] + before + count_size;
+					size_t n = (face_offsets[i + 1] - face_offsets[i] - before - count_size - after) / index_size;
+					if (n < 3)
+						continue;
+					uint32_t* out = &mesh->position_indices[3 * tri_offsets[i]];
+					uint32_t first = readPlyIndex(f, index_type, swap);
+					for (size_t k = 2; k < n; k++)
+					{
+						*out++ = first;
+						*out++ = readPlyIndex(f + (k - 1) * index_size, index_type, swap);
+						*out++ = readPlyIndex(f + k * index_size, index_type, swap);
+					}
+				}
+			});
+
+			p += face_offsets[element.count];
+		}
+		else
+		{
+			const size_t stride = element.getStride();
+			if (stride == 0 && element.count > 0)
+			{
+				std::cerr << "Unsupported PLY element \"" << element.name << "\"->" << filename << std::endl;
+				return nullptr;
+			}
+			if (stride > 0 && element.count > static_cast<size_t>(end - p) / stride)
+			{
+				std::cerr << "Truncated PLY element \"" << element.name << "\"->" << filename << std::endl;
+				return nullptr;
+			}
+			p += stride * element.count;
+		}
+	}
+
+	if (!indicesInRange(mesh->position_indices, mesh->getVertexCount()))
+	{
+		std::cerr << "Vertex index out of range in PLY->" << filename << std::endl;
+		return nullptr;
+	}
+
+	// PLY attributes are per vertex.
+	if (!mesh->normals.empty()) mesh->normal_indices = mesh->position_indices;
+	if (!mesh->texcoords.empty()) mesh->texcoord_indices = mesh->position_indices;
+
+	return mesh;
+}
+
+shared_ptr<MeshData> loadMesh(const char* filename)
+{
+	const char* dot = strrchr(filename, '.');
+	std::string ext = dot ? dot + 1 : "";
+	for (auto& c : ext)
+		c = static_cast<char>(tolower(c));
+
+	if (ext == "obj")
+		return loadOBJ(filename);
+	if (ext == "ply")
+		return loadPLY(filename);
+
+	std::cerr << "Unknown mesh format->" << filename << std::endl;
+	return nullptr;
+}
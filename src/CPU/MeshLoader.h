@@ -0,0 +1,15 @@
+#ifndef MESH_LOADER_H
+#define MESH_LOADER_H
+
+#include "Mesh.h"
+
+// Importers for Wavefront OBJ (v/vt/vn/f) and binary PLY. Files are read
+// through a memory mapping and parsed in parallel straight into MeshData.
+// All loaders return nullptr and report to std::cerr on failure.
+shared_ptr<MeshData> loadOBJ(const char* filename);
+shared_ptr<MeshData> loadPLY(const char* filename);
+
+// Picks the importer from the file extension.
+shared_ptr<MeshData> loadMesh(const char* filename);
+
+#endif // !MESH_LOADER_H
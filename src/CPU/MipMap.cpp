@@ -0,0 +1,138 @@
+#include "MipMap.h"
+
+#include <cstdint>
+
+#include <tbb/parallel_for.h>
+
+namespace
+{
+	// Interleaves the low 3 bits of x and y.
+	inline uint32_t morton8(uint32_t x, uint32_t y)
+	{
+		x = (x | (x << 2)) & 0x13;
+		x = (x | (x << 1)) & 0x15;
+		y = (y | (y << 2)) & 0x13;
+		y = (y | (y << 1)) & 0x15;
+		return x | (y << 1);
+	}
+}
+
+MipMap::MipMap(const unsigned char* pixels, int width, int height, int channels)
+{
+	// Level layout
+	size_t offset = 0;
+	int w = max(width, 1);
+	int h = max(height, 1);
+	while (true)
+	{
+		Level level;
+		level.width = w;
+		level.height = h;
+		level.tiles_x = (w + tile_size - 1) / tile_size;
+		level.offset = offset;
+		m_levels.push_back(level);
+
+		int tiles_y = (h + tile_size - 1) / tile_size;
+		offset += static_cast<size_t>(level.tiles_x) * tiles_y * tile_size * tile_size * texel_bytes;
+
+		if (w == 1 && h == 1)
+			break;
+		w = max(w / 2, 1);
+		h = max(h / 2, 1);
+	}
+	m_texels.resize(offset);
+
+	// Level 0 is a swizzled copy of the source.
+	const Level& base = m_levels[0];
+	tbb::parallel_for(tbb::blocked_range<int>(0, base.height), [&](const tbb::blocked_range<int>& r)
+	{
+		for (int y = r.begin(); y != r.end(); y++)
+		{
+			for (int x = 0; x < base.width; x++)
+			{
+				const unsigned char* src = pixels + (static_cast<size_t>(y) * width + x) * channels;
+				unsigned char* dst = &m_texels[getAddress(base, x, y)];
+				for (int c = 0; c < texel_bytes; c++)
+					dst[c] = src[c < channels ? c : channels - 1];
+			}
+		}
+	});
+
+	// Each further level is a 2x2 box filter of the previous one.
+	for (size_t l = 1; l < m_levels.size(); l++)
+	{
+		const Level& src = m_levels[l - 1];
+		const Level& dst = m_levels[l];
+		tbb::parallel_for(tbb::blocked_range<int>(0, dst.height), [&](const tbb::blocked_range<int>& r)
+		{
+			for (int y = r.begin(); y != r.end(); y++)
+			{
+				int y0 = min(2 * y, src.height - 1);
+				int y1 = min(2 * y + 1, src.height - 1);
+				for (int x = 0; x < dst.width; x++)
+				{
+					int x0 = min(2 * x, src.width - 1);
+					int x1 = min(2 * x + 1, src.width - 1);
+					const unsigned char* a = &m_texels[getAddress(src, x0, y0)];
+					const unsigned char* b = &m_texels[getAddress(src, x1, y0)];
+					const unsigned char* c = &m_texels[getAddress(src, x0, y1)];
+					const unsigned char* d = &m_texels[getAddress(src, x1, y1)];
+					unsigned char* out = &m_texels[getAddress(dst, x, y)];
+					for (int k = 0; k < texel_bytes; k++)
+						out[k] = static_cast<unsigned char>((a[k] + b[k] + c[k] + d[k] + 2) / 4);
+				}
+			}
+		});
+	}
+}
+
+size_t MipMap::getAddress(const Level& level, int x, int y) const
+{
+	size_t tile = static_cast<size_t>(y / tile_size) * level.tiles_x + x / tile_size;
+	size_t index = tile * tile_size * tile_size + morton8(x % tile_size, y % tile_size);
+	return level.offset + index * texel_bytes;
+}
+
+Color MipMap::texel(int level, int x, int y) const
+{
+	const Level& l = m_levels[level];
+	x = x < 0 ? 0 : (x >= l.width ? l.width - 1 : x);
+	y = y < 0 ? 0 : (y >= l.height ? l.height - 1 : y);
+
+	const double color_scale = 1.0 / 255.0;
+	const unsigned char* pixel = &m_texels[getAddress(l, x, y)];
+	return Color(color_scale * pixel[0], color_scale * pixel[1], color_scale * pixel[2]);
+}
+
+Color MipMap::bilinear(int level, double u, double v) const
+{
+	const Level& l = m_levels[level];
+	double x = u * l.width - 0.5;
+	double y = v * l.height - 0.5;
+	int x0 = static_cast<int>(floor(x));
+	int y0 = static_cast<int>(floor(y));
+	double fx = x - x0;
+	double fy = y - y0;
+
+	return (1 - fx) * (1 - fy) * texel(level, x0, y0)
+		+ fx * (1 - fy) * texel(level, x0 + 1, y0)
+		+ (1 - fx) * fy * texel(level, x0, y0 + 1)
+		+ fx * fy * texel(level, x0 + 1, y0 + 1);
+}
+
+Color MipMap::sample(double u, double v, double width) const
+{
+	// Level where one texel covers the footprint.
+	double texels = width * max(getWidth(), getHeight());
+	double lod = texels > 1.0 ? log2(texels) : 0.0;
+
+	const int last = getLevelCount() - 1;
+	if (lod >= last)
+		return bilinear(last, u, v);
+
+	int level = static_cast<int>(lod);
+	double t = lod - level;
+	if (t == 0.0)
+		return bilinear(level, u, v);
+	return (1 - t) * bilinear(level, u, v) + t * bilinear(level + 1, u, v);
+}
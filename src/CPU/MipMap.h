@@ -0,0 +1,49 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+#include <vector>
+
+#include "Math/Vector3.h"
+
+// 8-bit RGB image pyramid. Every level is stored in 8x8 texel tiles with the
+// texels of a tile in Morton order, so a bilinear footprint almost always
+// stays inside one 192-byte tile instead of spanning two image rows.
+class MipMap
+{
+public:
+	MipMap(const unsigned char* pixels, int width, int height, int channels);
+
+	int getWidth() const { return m_levels[0].width; }
+	int getHeight() const { return m_levels[0].height; }
+	int getLevelCount() const { return static_cast<int>(m_levels.size()); }
+	size_t getBytes() const { return m_texels.size(); }
+
+	// Texel with clamp-to-edge addressing.
+	Color texel(int level, int x, int y) const;
+
+	Color bilinear(int level, double u, double v) const;
+
+	// Trilinear lookup; width is the filter footprint in uv units (0 samples
+	// the finest level).
+	Color sample(double u, double v, double width) const;
+
+private:
+	static const int tile_size = 8;
+	static const int texel_bytes = 3;
+
+	struct Level
+	{
+		int width;
+		int height;
+		int tiles_x;
+		size_t offset;
+	};
+
+	size_t getAddress(const Level& level, int x, int y) const;
+
+private:
+	std::vector<Level> m_levels;
+	std::vector<unsigned char> m_texels;
+};
+
+#endif // !MIPMAP_H
@@ -0,0 +1,251 @@
+#include "Options.h"
+#include "Stats.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	bool isSwitch(const std::string& name)
+	{
+		return name == "aovs" || name == "denoise" || name == "heatmap" || name == "numa" || name == "pin" || name == "help";
+	}
+
+	bool parseInt(const char* text, int& value)
+	{
+		char* end;
+		long parsed = std::strtol(text, &end, 10);
+		if (end == text || *end != '\0')
+			return false;
+		value = static_cast<int>(parsed);
+		return true;
+	}
+
+	bool parseDouble(const char* text, double& value)
+	{
+		char* end;
+		double parsed = std::strtod(text, &end);
+		if (end == text || *end != '\0')
+			return false;
+		value = parsed;
+		return true;
+	}
+
+	bool parseBool(const char* text, bool& value)
+	{
+		if (!strcmp(text, "1") || !strcmp(text, "true") || !strcmp(text, "on") || !strcmp(text, "yes"))
+			value = true;
+		else if (!strcmp(text, "0") || !strcmp(text, "false") || !strcmp(text, "off") || !strcmp(text, "no"))
+			value = false;
+		else
+			return false;
+		return true;
+	}
+
+	// Scene by number or by name.
+	bool parseScene(const char* text, int& id)
+	{
+		if (parseInt(text, id))
+			return id >= 0 && id <= scene_count;
+
+		for (int i = 1; i <= scene_count; i++)
+		{
+			if (!strcmp(text, getSceneName(i)))
+			{
+				id = i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool parseFormats(const char* text, unsigned& formats)
+	{
+		formats = 0;
+		std::stringstream stream(text);
+		std::string item;
+		while (std::getline(stream, item, ','))
+		{
+			if (item == "png") formats |= ImageOutput::PNG;
+			else if (item == "exr") formats |= ImageOutput::EXR;
+			else if (item == "pfm") formats |= ImageOutput::PFM;
+			else return false;
+		}
+		return formats != 0;
+	}
+
+	// The one place options are set, for the command line and config files
+	// alike. Switches take a null value as true.
+	bool setOption(const std::string& name, const char* value, Options& options)
+	{
+		if (isSwitch(name))
+		{
+			bool on = true;
+			if (value && !parseBool(value, on))
+				return false;
+
+			if (name == "aovs") options.aovs = on;
+			else if (name == "denoise") options.denoise = on;
+			else if (name == "heatmap")
+			{
+				// Without the counters every heatmap would be blank.
+				if (on && !Stats::counters_enabled)
+				{
+					std::cerr << "Traversal heatmap needs a build with RT_ENABLE_STATS." << std::endl;
+					return false;
+				}
+				options.heatmap = on;
+			}
+			else if (name == "numa") options.numa = on;
+			else if (name == "pin") options.pin = on;
+			else options.help = on;
+			return true;
+		}
+
+		if (!value)
+			return false;
+
+		if (name == "scene") return parseScene(value, options.scene_id);
+		if (name == "scene-file") { options.scene_file = value; return true; }
+		if (name == "width") return parseInt(value, options.image_width) && options.image_width >= 0;
+		if (name == "height") return parseInt(value, options.image_height) && options.image_height >= 0;
+		if (name == "spp") return parseInt(value, options.samples_per_pixel) && options.samples_per_pixel >= 0;
+		if (name == "time") return parseDouble(value, options.time_budget) && options.time_budget >= 0.0;
+		if (name == "depth") return parseInt(value, options.max_depth) && options.max_depth > 0;
+		if (name == "threads") return parseInt(value, options.threads) && options.threads >= 0;
+		if (name == "tile") return parseInt(value, options.tile_size) && options.tile_size > 0;
+		if (name == "formats") return parseFormats(value, options.formats);
+		if (name == "output") { options.output = value; return true; }
+		if (name == "trace") { options.trace_file = value; return true; }
+
+		if (name == "seed")
+		{
+			char* end;
+			unsigned long seed = std::strtoul(value, &end, 10);
+			if (end == value || *end != '\0')
+				return false;
+			options.seed = static_cast<uint32_t>(seed);
+			return true;
+		}
+
+		if (name == "sampler")
+		{
+			if (!strcmp(value, "random")) options.sampler = Sampler::Random;
+			else if (!strcmp(value, "stratified")) options.sampler = Sampler::Stratified;
+			else return false;
+			return true;
+		}
+
+		return false;
+	}
+
+	std::string trim(const std::string& text)
+	{
+		const size_t first = text.find_first_not_of(" \t\r");
+		if (first == std::string::npos)
+			return std::string();
+		const size_t last = text.find_last_not_of(" \t\r");
+		return text.substr(first, last - first + 1);
+	}
+}
+
+bool parseCommandLine(int argc, char** argv, Options& options)
+{
+	for (int a = 1; a < argc; a++)
+	{
+		const char* arg = argv[a];
+		if (strncmp(arg, "--", 2) != 0)
+		{
+			std::cerr << "Unknown argument->" << arg << std::endl;
+			return false;
+		}
+
+		const std::string name = arg + 2;
+		const char* value = nullptr;
+		if (!isSwitch(name))
+		{
+			if (a + 1 >= argc)
+			{
+				std::cerr << "Missing value->" << arg << std::endl;
+				return false;
+			}
+			value = argv[++a];
+		}
+
+		if (name == "config")
+		{
+			if (!loadConfig(value, options))
+				return false;
+			continue;
+		}
+
+		if (!setOption(name, value, options))
+		{
+			std::cerr << "Bad option->" << arg << (value ? " " : "") << (value ? value : "") << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool loadConfig(const char* filename, Options& options)
+{
+	std::ifstream file(filename);
+	if (!file)
+	{
+		std::cerr << "Can not open config file->" << filename << std::endl;
+		return false;
+	}
+
+	std::string line;
+	int line_number = 0;
+	while (std::getline(file, line))
+	{
+		line_number++;
+		line = trim(line);
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		const size_t equals = line.find('=');
+		const std::string name = trim(line.substr(0, equals));
+		const std::string value = equals == std::string::npos ? std::string() : trim(line.substr(equals + 1));
+
+		if (equals == std::string::npos || name == "config" || !setOption(name, value.c_str(), options))
+		{
+			std::cerr << "Bad config line " << line_number << "->" << filename << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void printUsage(std::ostream& out, const char* program)
+{
+	out << "Usage: " << program << " [options]\n"
+		<< "  --scene <id|name>     built-in scene, 1-" << scene_count << " or its name (default final_scene)\n"
+		<< "  --scene-file <path>   scene description (.rtscene) or its compiled form (.rtsb)\n"
+		<< "  --width <pixels>      image width (default: the scene's)\n"
+		<< "  --height <pixels>     image height (default: the scene's)\n"
+		<< "  --spp <samples>       samples per pixel, per pass with --time (default: the scene's, " << time_budget_pass_spp << " with --time)\n"
+		<< "  --time <seconds>      render passes until the time is spent; a started pass always finishes\n"
+		<< "  --depth <bounces>     maximum ray depth (default 50)\n"
+		<< "  --seed <n>            random seed (default 0)\n"
+		<< "  --threads <n>         worker threads, 0 for all (default 0)\n"
+		<< "  --numa                one render arena and scene copy per NUMA node\n"
+		<< "  --pin                 bind render threads to cores\n"
+		<< "  --tile <pixels>       tile side, one tile per task (default 32)\n"
+		<< "  --sampler <name>      random or stratified (default random)\n"
+		<< "  --formats <list>      comma separated png, exr, pfm (default png,exr)\n"
+		<< "  --output <basename>   output path without extension\n"
+		<< "  --aovs                write the AOV channels into the EXR\n"
+		<< "  --denoise             denoise, also writes <basename>_noisy.exr\n"
+		<< "  --heatmap             BVH traversal heatmaps, needs RT_ENABLE_STATS\n"
+		<< "  --trace <file>        write a Chrome trace of the run\n"
+		<< "  --config <file>       read \"name = value\" lines with the names above\n"
+		<< "  --help                print this and exit\n";
+}
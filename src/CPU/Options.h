@@ -0,0 +1,58 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "ImageOutput.h"
+#include "Renderer.h"
+
+// Samples per pass when there is a time budget and no sample count. The
+// budget is checked between whole passes, so a pass must be short.
+const int time_budget_pass_spp = 4;
+
+// Run settings for the renderer, from the command line and config files.
+// Zero for the resolution or sample count keeps the scene's own value, or
+// uses time_budget_pass_spp with a time budget.
+struct Options
+{
+	int scene_id = 0;				// 0 or unknown picks final_scene
+	std::string scene_file;			// .rtscene or .rtsb, instead of a built-in scene
+	int image_width = 0;
+	int image_height = 0;
+	int samples_per_pixel = 0;		// per pass when there is a time budget
+	double time_budget = 0.0;		// seconds
+	int max_depth = 50;
+	uint32_t seed = 0;
+	int threads = 0;				// 0 uses every hardware thread
+	bool numa = false;				// an arena and a scene copy per NUMA node
+	bool pin = false;				// bind render threads to cores
+	int tile_size = 32;
+	Sampler sampler = Sampler::Random;
+
+	unsigned formats = ImageOutput::PNG | ImageOutput::EXR;
+	std::string output = "./final_scene_parallel_fix";	// basename, extensions are added
+	bool aovs = false;
+	bool denoise = false;			// renders the AOVs it needs either way
+	bool heatmap = false;			// BVH cost per pixel, needs RT_ENABLE_STATS
+	std::string trace_file;			// for chrome://tracing or Perfetto
+
+	bool help = false;
+};
+
+// Applies argv over options. Options are "--name value", or "--name" alone
+// for switches; "--config file" applies a config file in place, so later
+// arguments override it. Returns false and reports to std::cerr on a bad
+// option.
+bool parseCommandLine(int argc, char** argv, Options& options);
+
+// Applies a config file of "name = value" lines over options, with the same
+// names as the command line without the dashes. Blank lines and lines
+// starting with '#' are skipped. Returns false and reports to std::cerr if
+// the file cannot be read or has a bad line.
+bool loadConfig(const char* filename, Options& options);
+
+void printUsage(std::ostream& out, const char* program);
+
+#endif // !OPTIONS_H
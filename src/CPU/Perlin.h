@@ -1,6 +1,12 @@
 #ifndef PERLIN_H
 #define PERLIN_H
 
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 inline double trilinear_interp(double c[2][2][2], double u, double v, double w)
 {
 	double accum = 0.0;
@@ -11,9 +17,9 @@ inline double trilinear_interp(double c[2][2][2], double u, double v, double w)
 		{
 			for (int k = 0; k < 2; k++)
 			{
-				accum += (i * u + (1 - i)*(1 - u)) * 
-					(j * v + (1 - j)*(1 - v)) * 
-					(k * w + (1 - k)*(1 - w)) * 
+				accum += (i * u + (1 - i)*(1 - u)) *
+					(j * v + (1 - j)*(1 - v)) *
+					(k * w + (1 - k)*(1 - w)) *
 					c[i][j][k];
 			}
 		}
@@ -22,59 +28,114 @@ inline double trilinear_interp(double c[2][2][2], double u, double v, double w)
 	return accum;
 }
 
+// Gradient noise with compact tables: float gradients stored per component and
+// the three permutations in one array. The batch entry points evaluate four
+// points per step with AVX2 (scalar otherwise); turb() runs its octaves as
+// one such batch.
 class Perlin
 {
 public:
 	Perlin()
 	{
-		ranvec = new Vector3[point_count];
 		for (int i = 0; i < point_count; i++)
 		{
-			ranvec[i] = Vector3::random(-1, 1);
+			Vector3 g = Vector3::random(-1, 1);
+			m_grad_x[i] = static_cast<float>(g.x);
+			m_grad_y[i] = static_cast<float>(g.y);
+			m_grad_z[i] = static_cast<float>(g.z);
 		}
 
-		perm_x = perlin_generate_perm();
-		perm_y = perlin_generate_perm();
-		perm_z = perlin_generate_perm();
-	}
-
-	~Perlin()
-	{
-		delete[] ranvec;
-		delete[] perm_x;
-		delete[] perm_y;
-		delete[] perm_z;
+		perlin_generate_perm(m_perm + 0 * point_count);
+		perlin_generate_perm(m_perm + 1 * point_count);
+		perlin_generate_perm(m_perm + 2 * point_count);
 	}
 
 	double noise(const Point3& p) const
 	{
-		double u = p.x - floor(p.x);
-		double v = p.y - floor(p.y);
-		double w = p.z - floor(p.z);
-		int i = floor(p.x);
-		int j = floor(p.y);
-		int k = floor(p.z);
-		Vector3 c[2][2][2];
+		double fx = floor(p.x);
+		double fy = floor(p.y);
+		double fz = floor(p.z);
+		double u = p.x - fx;
+		double v = p.y - fy;
+		double w = p.z - fz;
+		int i = static_cast<int>(fx);
+		int j = static_cast<int>(fy);
+		int k = static_cast<int>(fz);
+
+		const int32_t* perm_x = m_perm;
+		const int32_t* perm_y = m_perm + point_count;
+		const int32_t* perm_z = m_perm + 2 * point_count;
+		int32_t x[2] = { perm_x[i & 255], perm_x[(i + 1) & 255] };
+		int32_t y[2] = { perm_y[j & 255], perm_y[(j + 1) & 255] };
+		int32_t z[2] = { perm_z[k & 255], perm_z[(k + 1) & 255] };
 
+		double uu = u * u * (3 - 2 * u);
+		double vv = v * v * (3 - 2 * v);
+		double ww = w * w * (3 - 2 * w);
+
+		double accum = 0.0;
 		for (int di = 0; di < 2; di++)
+		{
+			double wx = di ? uu : 1 - uu;
 			for (int dj = 0; dj < 2; dj++)
+			{
+				double wy = dj ? vv : 1 - vv;
 				for (int dk = 0; dk < 2; dk++)
-					c[di][dj][dk] = ranvec[
-						perm_x[(i + di) & 255] ^
-						perm_y[(j + dj) & 255] ^
-						perm_z[(k + dk) & 255]
-					];
+				{
+					double wz = dk ? ww : 1 - ww;
+					int32_t h = x[di] ^ y[dj] ^ z[dk];
+					double dot = m_grad_x[h] * (u - di) + m_grad_y[h] * (v - dj) + m_grad_z[h] * (w - dk);
+					accum += wx * wy * wz * dot;
+				}
+			}
+		}
 
-		return perlin_interp(c, u, v, w);
+		return accum;
+	}
+
+	// out[i] = noise(p[i]) for n points.
+	void noise(const Point3* p, double* out, size_t n) const
+	{
+		size_t i = 0;
+#if defined(__AVX2__)
+		for (; i + 4 <= n; i += 4)
+		{
+			__m256d px = _mm256_set_pd(p[i + 3].x, p[i + 2].x, p[i + 1].x, p[i].x);
+			__m256d py = _mm256_set_pd(p[i + 3].y, p[i + 2].y, p[i + 1].y, p[i].y);
+			__m256d pz = _mm256_set_pd(p[i + 3].z, p[i + 2].z, p[i + 1].z, p[i].z);
+			_mm256_storeu_pd(out + i, noise4(px, py, pz));
+		}
+#endif
+		for (; i < n; i++)
+			out[i] = noise(p[i]);
 	}
 
 	double turb(const Point3& p, int depth = 7) const
 	{
 		double accum = 0.0;
-		auto temp_p = p;
-		double weight = 1.0;
+		int i = 0;
 
-		for (int i = 0; i < depth; i++)
+#if defined(__AVX2__)
+		// Four octaves per vector.
+		for (; i + 4 <= depth; i += 4)
+		{
+			const double s0 = static_cast<double>(1ull << i);
+			__m256d scale = _mm256_set_pd(8 * s0, 4 * s0, 2 * s0, s0);
+			__m256d n = noise4(
+				_mm256_mul_pd(_mm256_set1_pd(p.x), scale),
+				_mm256_mul_pd(_mm256_set1_pd(p.y), scale),
+				_mm256_mul_pd(_mm256_set1_pd(p.z), scale));
+
+			alignas(32) double terms[4];
+			_mm256_store_pd(terms, _mm256_div_pd(n, scale));
+			accum += terms[0] + terms[1] + terms[2] + terms[3];
+		}
+#endif
+
+		auto temp_p = p * static_cast<double>(1ull << i);
+		double weight = 1.0 / static_cast<double>(1ull << i);
+
+		for (; i < depth; i++)
 		{
 			accum += weight * noise(temp_p);
 			weight *= 0.5;
@@ -84,62 +145,127 @@ public:
 		return fabs(accum);
 	}
 
+	// out[i] = turb(p[i], depth) for n points, up to rounding.
+	void turb(const Point3* p, double* out, size_t n, int depth = 7) const
+	{
+		size_t i = 0;
+#if defined(__AVX2__)
+		// Four points per vector, one octave per step.
+		const __m256d two = _mm256_set1_pd(2.0);
+		const __m256d half = _mm256_set1_pd(0.5);
+		const __m256d sign = _mm256_set1_pd(-0.0);
+		for (; i + 4 <= n; i += 4)
+		{
+			__m256d px = _mm256_set_pd(p[i + 3].x, p[i + 2].x, p[i + 1].x, p[i].x);
+			__m256d py = _mm256_set_pd(p[i + 3].y, p[i + 2].y, p[i + 1].y, p[i].y);
+			__m256d pz = _mm256_set_pd(p[i + 3].z, p[i + 2].z, p[i + 1].z, p[i].z);
+			__m256d weight = _mm256_set1_pd(1.0);
+			__m256d accum = _mm256_setzero_pd();
+			for (int octave = 0; octave < depth; octave++)
+			{
+				accum = _mm256_add_pd(accum, _mm256_mul_pd(weight, noise4(px, py, pz)));
+				weight = _mm256_mul_pd(weight, half);
+				px = _mm256_mul_pd(px, two);
+				py = _mm256_mul_pd(py, two);
+				pz = _mm256_mul_pd(pz, two);
+			}
+			_mm256_storeu_pd(out + i, _mm256_andnot_pd(sign, accum));
+		}
+#endif
+		for (; i < n; i++)
+			out[i] = turb(p[i], depth);
+	}
+
 private:
 	static const int point_count = 256;
-	// double* ranfloat;
-	Vector3* ranvec;
-	int* perm_x;
-	int* perm_y;
-	int* perm_z;
+	float m_grad_x[point_count];
+	float m_grad_y[point_count];
+	float m_grad_z[point_count];
+	int32_t m_perm[3 * point_count];	// x, y and z permutations back to back
 
-	static int* perlin_generate_perm()
+	static void perlin_generate_perm(int32_t* p)
 	{
-		auto p = new int[point_count];
-
 		for (int i = 0; i < Perlin::point_count; i++)
 			p[i] = i;
 
 		permute(p, point_count);
-
-		return p;
 	}
 
-	static void permute(int *p, int n)
+	static void permute(int32_t *p, int n)
 	{
 		for (int i = n - 1; i > 0; i--)
 		{
 			int target = random_int(0, i);
-			int tmp = p[i];
+			int32_t tmp = p[i];
 			p[i] = p[target];
 			p[target] = tmp;
 		}
 	}
 
-	inline double perlin_interp(Vector3 c[2][2][2], double u, double v, double w) const
+#if defined(__AVX2__)
+	inline __m256d noise4(__m256d px, __m256d py, __m256d pz) const
 	{
-		double uu = u * u * (3 - 2 * u);
-		double vv = v * v * (3 - 2 * v);
-		double ww = w * w * (3 - 2 * w);
+		const __m256d one = _mm256_set1_pd(1.0);
+		const __m256d three = _mm256_set1_pd(3.0);
+		const __m256d two = _mm256_set1_pd(2.0);
+		const __m128i mask = _mm_set1_epi32(255);
+		const __m128i inc = _mm_set1_epi32(1);
 
-		double accum = 0.0;
+		__m256d fx = _mm256_floor_pd(px);
+		__m256d fy = _mm256_floor_pd(py);
+		__m256d fz = _mm256_floor_pd(pz);
+		__m256d u = _mm256_sub_pd(px, fx);
+		__m256d v = _mm256_sub_pd(py, fy);
+		__m256d w = _mm256_sub_pd(pz, fz);
+		__m128i i = _mm256_cvttpd_epi32(fx);
+		__m128i j = _mm256_cvttpd_epi32(fy);
+		__m128i k = _mm256_cvttpd_epi32(fz);
 
-		for (int i = 0; i < 2; i++)
+		const int* perm = reinterpret_cast<const int*>(m_perm);
+		__m128i x[2] = {
+			_mm_i32gather_epi32(perm, _mm_and_si128(i, mask), 4),
+			_mm_i32gather_epi32(perm, _mm_and_si128(_mm_add_epi32(i, inc), mask), 4) };
+		__m128i y[2] = {
+			_mm_i32gather_epi32(perm + point_count, _mm_and_si128(j, mask), 4),
+			_mm_i32gather_epi32(perm + point_count, _mm_and_si128(_mm_add_epi32(j, inc), mask), 4) };
+		__m128i z[2] = {
+			_mm_i32gather_epi32(perm + 2 * point_count, _mm_and_si128(k, mask), 4),
+			_mm_i32gather_epi32(perm + 2 * point_count, _mm_and_si128(_mm_add_epi32(k, inc), mask), 4) };
+
+		// Hermite weights
+		__m256d uu = _mm256_mul_pd(_mm256_mul_pd(u, u), _mm256_sub_pd(three, _mm256_mul_pd(two, u)));
+		__m256d vv = _mm256_mul_pd(_mm256_mul_pd(v, v), _mm256_sub_pd(three, _mm256_mul_pd(two, v)));
+		__m256d ww = _mm256_mul_pd(_mm256_mul_pd(w, w), _mm256_sub_pd(three, _mm256_mul_pd(two, w)));
+		__m256d wx[2] = { _mm256_sub_pd(one, uu), uu };
+		__m256d wy[2] = { _mm256_sub_pd(one, vv), vv };
+		__m256d wz[2] = { _mm256_sub_pd(one, ww), ww };
+		__m256d dx[2] = { u, _mm256_sub_pd(u, one) };
+		__m256d dy[2] = { v, _mm256_sub_pd(v, one) };
+		__m256d dz[2] = { w, _mm256_sub_pd(w, one) };
+
+		__m256d accum = _mm256_setzero_pd();
+		for (int di = 0; di < 2; di++)
 		{
-			for (int j = 0; j < 2; j++)
+			for (int dj = 0; dj < 2; dj++)
 			{
-				for (int k = 0; k < 2; k++)
+				__m128i xy = _mm_xor_si128(x[di], y[dj]);
+				__m256d wxy = _mm256_mul_pd(wx[di], wy[dj]);
+				for (int dk = 0; dk < 2; dk++)
 				{
-					Vector3 weight_v(u - i, v - j, w - k);
-					accum += (i * uu + (1 - i) * (1 - uu)) *
-						(j * vv + (1 - j) * (1 - vv)) *
-						(k * ww + (1 - k) * (1 - ww)) *
-						c[i][j][k].dotProduct(weight_v);
+					__m128i h = _mm_xor_si128(xy, z[dk]);
+					__m256d gx = _mm256_cvtps_pd(_mm_i32gather_ps(m_grad_x, h, 4));
+					__m256d gy = _mm256_cvtps_pd(_mm_i32gather_ps(m_grad_y, h, 4));
+					__m256d gz = _mm256_cvtps_pd(_mm_i32gather_ps(m_grad_z, h, 4));
+					__m256d dot = _mm256_add_pd(_mm256_add_pd(
+						_mm256_mul_pd(gx, dx[di]), _mm256_mul_pd(gy, dy[dj])), _mm256_mul_pd(gz, dz[dk]));
+					accum = _mm256_add_pd(accum, _mm256_mul_pd(_mm256_mul_pd(wxy, wz[dk]), dot));
 				}
 			}
 		}
 
 		return accum;
 	}
+#endif
 };
 
 #endif // !PERLIN_H
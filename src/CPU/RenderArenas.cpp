@@ -0,0 +1,225 @@
+#include "RenderArenas.h"
+
+#include <tbb/info.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+	// Binds each thread entering the arena to one core of the cores it may
+	// already run on (its node's, under a NUMA constraint), picked by its
+	// slot in the arena, and restores the old affinity on exit.
+	class CorePinning : public tbb::task_scheduler_observer
+	{
+	public:
+		CorePinning(tbb::task_arena& arena, int numa_node)
+			: tbb::task_scheduler_observer(arena), m_numa_node(numa_node)
+		{
+			observe(true);
+		}
+
+		~CorePinning()
+		{
+			observe(false);
+		}
+
+		virtual void on_scheduler_entry(bool) override
+		{
+			if (t_pinned)
+				return;
+
+			const int slot = tbb::this_task_arena::current_thread_index();
+			if (slot < 0)
+				return;
+
+#ifdef _WIN32
+			ULONGLONG allowed = 0;
+			DWORD_PTR process_mask, system_mask;
+			if (m_numa_node >= 0)
+				GetNumaNodeProcessorMask(static_cast<UCHAR>(m_numa_node), &allowed);
+			else if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+				allowed = process_mask;
+
+			int count = 0;
+			for (int cpu = 0; cpu < 64; cpu++)
+				count += (allowed >> cpu) & 1;
+			if (count == 0)
+				return;
+
+			int target = slot % count;
+			for (int cpu = 0; cpu < 64; cpu++)
+			{
+				if ((allowed >> cpu) & 1)
+				{
+					if (target-- == 0)
+					{
+						t_saved = SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu);
+						t_pinned = t_saved != 0;
+						return;
+					}
+				}
+			}
+#elif defined(__linux__)
+			cpu_set_t allowed;
+			if (pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed) != 0)
+				return;
+
+			const int count = CPU_COUNT(&allowed);
+			if (count == 0)
+				return;
+
+			int target = slot % count;
+			for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			{
+				if (CPU_ISSET(cpu, &allowed) && target-- == 0)
+				{
+					cpu_set_t single;
+					CPU_ZERO(&single);
+					CPU_SET(cpu, &single);
+					t_saved = allowed;
+					t_pinned = pthread_setaffinity_np(pthread_self(), sizeof(single), &single) == 0;
+					return;
+				}
+			}
+#endif
+		}
+
+		virtual void on_scheduler_exit(bool) override
+		{
+			if (!t_pinned)
+				return;
+
+#ifdef _WIN32
+			SetThreadAffinityMask(GetCurrentThread(), t_saved);
+#elif defined(__linux__)
+			pthread_setaffinity_np(pthread_self(), sizeof(t_saved), &t_saved);
+#endif
+			t_pinned = false;
+		}
+
+	private:
+		int m_numa_node;
+
+		// Threads move between arenas, so the saved affinity is per thread.
+		static thread_local bool t_pinned;
+#ifdef _WIN32
+		static thread_local DWORD_PTR t_saved;
+#elif defined(__linux__)
+		static thread_local cpu_set_t t_saved;
+#endif
+	};
+
+	thread_local bool CorePinning::t_pinned = false;
+#ifdef _WIN32
+	thread_local DWORD_PTR CorePinning::t_saved = 0;
+#elif defined(__linux__)
+	thread_local cpu_set_t CorePinning::t_saved;
+#endif
+}
+
+RenderArenas::Arena::Arena(int numa_node, int concurrency, unsigned reserved_for_masters)
+	: arena(tbb::task_arena::constraints(numa_node, concurrency), reserved_for_masters),
+	numa_node(numa_node),
+	concurrency(concurrency)
+{
+}
+
+RenderArenas::RenderArenas(const Config& config)
+	: m_pinned(config.pin)
+{
+	std::vector<tbb::numa_node_id> nodes = { -1 };
+	if (config.numa)
+		nodes = tbb::info::numa_nodes();
+
+	std::vector<int> capacity(nodes.size());
+	int total_capacity = 0;
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		capacity[n] = tbb::info::default_concurrency(nodes[n]);
+		total_capacity += capacity[n];
+	}
+
+	// Threads go to the nodes in turn, skipping full ones, so a partial
+	// count still uses every node's memory bandwidth.
+	const int threads = config.threads > 0 ? config.threads : total_capacity;
+	std::vector<int> counts(nodes.size(), 0);
+	for (int t = 0, n = 0; t < threads; n = (n + 1) % static_cast<int>(nodes.size()))
+	{
+		if (counts[n] < capacity[n] || t >= total_capacity)
+		{
+			counts[n]++;
+			t++;
+		}
+	}
+
+	for (size_t n = 0; n < nodes.size(); n++)
+	{
+		if (counts[n] == 0)
+			continue;
+
+		// Only the first arena keeps a slot for the calling thread; it
+		// waits there first in executeAll(), so the others get only workers.
+		m_arenas.push_back(std::make_unique<Arena>(nodes[n], counts[n], m_arenas.empty() ? 1 : 0));
+		Arena& a = *m_arenas.back();
+		a.arena.initialize();
+		if (config.pin)
+			a.pinning = std::make_unique<CorePinning>(a.arena, a.numa_node);
+	}
+}
+
+RenderArenas::~RenderArenas()
+{
+	// Observers go before their arenas.
+	for (auto& a : m_arenas)
+		a->pinning.reset();
+}
+
+int RenderArenas::getTotalConcurrency() const
+{
+	int total = 0;
+	for (const auto& a : m_arenas)
+		total += a->concurrency;
+	return total;
+}
+
+void RenderArenas::print(std::ostream& out) const
+{
+	out << "Render arenas:";
+	for (size_t i = 0; i < m_arenas.size(); i++)
+	{
+		out << (i ? ", " : " ") << m_arenas[i]->concurrency << " threads";
+		if (m_arenas[i]->numa_node >= 0)
+			out << " on NUMA node " << m_arenas[i]->numa_node;
+	}
+	out << (m_pinned ? ", pinned to cores" : "") << '\n';
+}
+
+bool SceneReplicas::build(RenderArenas& arenas, bool replicate, uint32_t seed, const Builder& build)
+{
+	const size_t copies = replicate ? arenas.getCount() : 1;
+	for (size_t i = 0; i < copies; i++)
+	{
+		m_arenas.push_back(std::make_unique<SceneArena>());
+		m_scenes.push_back(std::make_unique<Scene>());
+
+		bool built = false;
+		arenas.execute(i, [&]
+		{
+			random_seed(seed);
+			built = build(*m_arenas[i], *m_scenes[i]);
+		});
+		if (!built)
+			return false;
+	}
+
+	m_pointers.clear();
+	for (size_t i = 0; i < arenas.getCount(); i++)
+		m_pointers.push_back(m_scenes[replicate ? i : 0].get());
+	return true;
+}
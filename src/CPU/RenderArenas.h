@@ -0,0 +1,113 @@
+#ifndef RENDER_ARENAS_H
+#define RENDER_ARENAS_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include <tbb/task_arena.h>
+#include <tbb/task_group.h>
+#include <tbb/task_scheduler_observer.h>
+
+#include "Scenes.h"
+
+// The task arenas a frame is rendered in. By default this is one arena with
+// the requested number of threads. With NUMA placement there is one arena per
+// NUMA node TBB reports (it needs its hwloc-based tbbbind library to see
+// more than one), each kept on its node's cores, so the memory a scene
+// replica first touches while built inside arena i lands on node i. With
+// pinning, each thread is also bound to a single core while it works in an
+// arena, and gets its old affinity back when it leaves.
+class RenderArenas
+{
+public:
+	struct Config
+	{
+		int threads = 0;	// 0 uses every core; otherwise spread over the nodes in turn
+		bool numa = false;
+		bool pin = false;
+	};
+
+	explicit RenderArenas(const Config& config);
+	~RenderArenas();
+
+	RenderArenas(const RenderArenas&) = delete;
+	RenderArenas& operator=(const RenderArenas&) = delete;
+
+	size_t getCount() const { return m_arenas.size(); }
+	int getNumaNode(size_t i) const { return m_arenas[i]->numa_node; }	// -1 without NUMA placement
+	int getConcurrency(size_t i) const { return m_arenas[i]->concurrency; }
+	int getTotalConcurrency() const;
+
+	// Runs f inside arena i on the calling thread.
+	template<typename F>
+	void execute(size_t i, const F& f)
+	{
+		m_arenas[i]->arena.execute(f);
+	}
+
+	// Runs f(i) inside every arena i at once and returns when all are done.
+	template<typename F>
+	void executeAll(const F& f)
+	{
+		for (size_t i = 0; i < m_arenas.size(); i++)
+		{
+			Arena& a = *m_arenas[i];
+			a.arena.execute([&a, &f, i] { a.group.run([&f, i] { f(i); }); });
+		}
+		for (size_t i = 0; i < m_arenas.size(); i++)
+		{
+			Arena& a = *m_arenas[i];
+			a.arena.execute([&a] { a.group.wait(); });
+		}
+	}
+
+	void print(std::ostream& out) const;
+
+private:
+	struct Arena
+	{
+		Arena(int numa_node, int concurrency, unsigned reserved_for_masters);
+
+		tbb::task_arena arena;
+		tbb::task_group group;
+		std::unique_ptr<tbb::task_scheduler_observer> pinning;
+		int numa_node;
+		int concurrency;
+	};
+
+private:
+	std::vector<std::unique_ptr<Arena>> m_arenas;
+	bool m_pinned = false;
+};
+
+// The scenes the arenas of a frame trace against. Replicated, every arena
+// gets its own copy, built inside that arena so that its hittables and BVH
+// are first touched, and so placed, on the arena's NUMA node; images are
+// still shared through the TextureCache. Otherwise one scene, built in the
+// first arena, is shared by all of them.
+class SceneReplicas
+{
+public:
+	using Builder = std::function<bool(SceneArena& arena, Scene& scene)>;
+
+	// Calls build for each copy, reseeding the random generator with seed
+	// first so random scenes come out the same. Returns false as soon as
+	// build does.
+	bool build(RenderArenas& arenas, bool replicate, uint32_t seed, const Builder& build);
+
+	// One per arena, for render().
+	const std::vector<const Scene*>& getScenes() const { return m_pointers; }
+	const Scene& getScene(size_t i) const { return *m_pointers[i]; }
+	const SceneArena& getArena(size_t i) const { return *m_arenas[i]; }
+
+private:
+	// Scenes are declared last so they go before the arenas they live in.
+	std::vector<std::unique_ptr<SceneArena>> m_arenas;
+	std::vector<std::unique_ptr<Scene>> m_scenes;
+	std::vector<const Scene*> m_pointers;
+};
+
+#endif // !RENDER_ARENAS_H
@@ -0,0 +1,245 @@
+#include "Renderer.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include <tbb/parallel_for.h>
+
+#include "Material.h"
+#include "RenderArenas.h"
+#include "Stats.h"
+#include "Trace.h"
+
+namespace
+{
+	// Rays traced by this thread, for RenderResult.
+	thread_local uint64_t t_rays = 0;
+
+	// SplitMix64 finalizer, spreads nearby task indices over the seed space.
+	uint32_t taskSeed(uint32_t seed, uint64_t task)
+	{
+		uint64_t z = (static_cast<uint64_t>(seed) * 0x9e3779b97f4a7c15ull) ^ (task + 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return static_cast<uint32_t>(z ^ (z >> 31));
+	}
+}
+
+Color ray_color(const Ray& r, const Color& background, const Hittable& world, int depth,
+	double spread, double distance, AOVSample* aov)
+{
+	HitRecord rec;
+
+	// If we've exceeded the ray bounce limit, no more light is gathered.
+	if (depth <= 0)
+		return Color(0, 0, 0);
+
+	// If the ray hits nothing, return the background color.
+	t_rays++;
+	RT_STAT_INC(TracedRays);
+	if (!world.hit(r, 0.001, infinity, rec))
+		return background;
+
+	distance += rec.t;
+	rec.footprint = spread * distance * rec.uv_density;
+
+	if (aov != nullptr)
+	{
+		aov->albedo = rec.mat_ptr->albedo(rec);
+		aov->normal = rec.normal;
+		aov->depth = distance;
+		aov->material_id = rec.mat_ptr->getID();
+	}
+
+	Ray scattered;
+	Color attenuation;
+	Color emitted = rec.mat_ptr->emitted(rec.u, rec.v, rec.position);
+
+	if (!rec.mat_ptr->scatter(r, rec, attenuation, scattered))
+		return emitted;
+
+	return emitted + attenuation * ray_color(scattered, background, world, depth - 1, spread, distance);
+}
+
+namespace
+{
+	// One frame in progress. Tiles are claimed from next_tile by every
+	// thread of every arena, so faster nodes take more of them.
+	struct Frame
+	{
+		const RenderSettings& settings;
+		int samples_per_pixel;
+		int tile_size;
+		int strata;
+		int tiles_x;
+		int tile_count;
+
+		std::vector<Color> sums;	// radiance sums, rows top to bottom like the framebuffer
+		AOVBuffer& aovs;
+		std::atomic<uint64_t> rays{ 0 };
+		std::atomic<int> next_tile{ 0 };
+		std::atomic<int> tiles_done{ 0 };
+
+		Frame(const RenderSettings& s, AOVBuffer& a)
+			: settings(s),
+			samples_per_pixel(max(s.samples_per_pixel, 1)),
+			tile_size(max(s.tile_size, 1)),
+			strata(s.sampler == Sampler::Stratified ? static_cast<int>(sqrt(static_cast<double>(samples_per_pixel))) : 0),
+			tiles_x((s.image_width + tile_size - 1) / tile_size),
+			tile_count(tiles_x * ((s.image_height + tile_size - 1) / tile_size)),
+			sums(static_cast<size_t>(s.image_width) * s.image_height, Color(0, 0, 0)),
+			aovs(a)
+		{}
+	};
+
+	// Tile seeds depend only on the seed, the pass and the tile index, never
+	// on which thread or node renders the tile.
+	void renderTile(Frame& frame, const Scene& scene, int pass, int tile)
+	{
+		const RenderSettings& settings = frame.settings;
+		const int image_width = settings.image_width;
+		const int image_height = settings.image_height;
+		const int samples_per_pixel = frame.samples_per_pixel;
+		const int strata = frame.strata;
+		const bool capture_aovs = settings.capture_aovs && pass == 0;
+
+		const Camera cam = scene.getCamera(static_cast<double>(image_width) / image_height);
+		const double pixel_spread = 2.0 * tan(degreeToRadian(scene.vfov) / 2.0) / image_height;
+
+		const int x0 = (tile % frame.tiles_x) * frame.tile_size;
+		const int y0 = (tile / frame.tiles_x) * frame.tile_size;
+		const int x1 = min(x0 + frame.tile_size, image_width);
+		const int y1 = min(y0 + frame.tile_size, image_height);
+
+		Trace::Scope span("tile", "render", "x", x0, "y", y0);
+		random_seed(taskSeed(settings.seed, (static_cast<uint64_t>(pass) << 32) | static_cast<uint32_t>(tile)));
+		const uint64_t rays_before = t_rays;
+
+		for (int y = y0; y < y1; y++)
+		{
+			// j counts up from the bottom of the image.
+			const int j = image_height - 1 - y;
+			for (int i = x0; i < x1; i++)
+			{
+				Color pixel_color(0, 0, 0);
+				AOVBuffer::Accumulator aov_pixel;
+				// The per-pixel timer only runs when AOVs are captured.
+				std::chrono::steady_clock::time_point pixel_start;
+				if (capture_aovs)
+					pixel_start = std::chrono::steady_clock::now();
+
+				for (int s = 0; s < samples_per_pixel; ++s)
+				{
+					// Stratified sampling jitters within a strata x strata grid;
+					// samples past the last full grid fall back to random.
+					double du, dv;
+					if (s < strata * strata)
+					{
+						du = (s % strata + random_double()) / strata;
+						dv = (s / strata + random_double()) / strata;
+					}
+					else
+					{
+						du = random_double();
+						dv = random_double();
+					}
+
+					auto u = (i + du) / (image_width - 1);
+					auto v = (j + dv) / (image_height - 1);
+					Ray r = cam.getRay(u, v);
+
+					if (!capture_aovs)
+					{
+						pixel_color += ray_color(r, scene.background, scene.world, settings.max_depth, pixel_spread);
+						continue;
+					}
+
+					AOVSample aov;
+					Stats::TraversalProbe probe;
+					pixel_color += ray_color(r, scene.background, scene.world, settings.max_depth, pixel_spread, 0.0, &aov);
+					aov.traversal = probe.read();
+					aov_pixel.add(aov);
+				}
+
+				if (capture_aovs)
+				{
+					std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - pixel_start;
+					frame.aovs.setPixel(i, y, aov_pixel, seconds.count());
+				}
+				frame.sums[static_cast<size_t>(y) * image_width + i] += pixel_color;
+				RT_STAT_ADD(PrimaryRays, samples_per_pixel);
+			}
+		}
+
+		frame.rays += t_rays - rays_before;
+
+		// One write per tile, built first so threads do not interleave.
+		int done = ++frame.tiles_done;
+		if (settings.show_progress)
+			std::cerr << "\rPass " + std::to_string(pass + 1) + ", tiles remaining: " + std::to_string(frame.tile_count - done) + ' ' << std::flush;
+	}
+
+	// Every thread of the calling arena claims tiles until none are left.
+	void renderTiles(Frame& frame, const Scene& scene, int pass)
+	{
+		const int workers = tbb::this_task_arena::max_concurrency();
+		tbb::parallel_for(0, workers, [&](int)
+		{
+			for (int tile = frame.next_tile++; tile < frame.tile_count; tile = frame.next_tile++)
+				renderTile(frame, scene, pass, tile);
+		}, tbb::simple_partitioner());
+	}
+
+	// Renders passes until the settings are met; forEachArena(f) must call
+	// f(i) for every arena i, each in its own arena.
+	template<typename ForEachArena>
+	RenderResult renderFrame(const Scene* const* scenes, const ForEachArena& forEachArena,
+		const RenderSettings& settings, Framebuffer& image, AOVBuffer& aovs)
+	{
+		if (settings.capture_aovs)
+			aovs.resize(settings.image_width, settings.image_height);
+
+		Frame frame(settings, aovs);
+
+		RenderResult result;
+		auto start = std::chrono::steady_clock::now();
+		Stats::ScopedTimer render_timer(Stats::Render);
+
+		for (int pass = 0; ; pass++)
+		{
+			frame.next_tile = 0;
+			frame.tiles_done = 0;
+			forEachArena([&](size_t i) { renderTiles(frame, *scenes[i], pass); });
+
+			result.passes = pass + 1;
+			result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (settings.time_budget <= 0.0 || result.seconds >= settings.time_budget)
+				break;
+		}
+		render_timer.stop();
+
+		result.samples_per_pixel = result.passes * frame.samples_per_pixel;
+		result.rays = frame.rays;
+
+		image.resize(settings.image_width, settings.image_height);
+		const double scale = 1.0 / result.samples_per_pixel;
+		for (int y = 0; y < settings.image_height; y++)
+			for (int x = 0; x < settings.image_width; x++)
+				image.setPixel(x, y, frame.sums[static_cast<size_t>(y) * settings.image_width + x] * scale);
+
+		return result;
+	}
+}
+
+RenderResult render(const Scene& scene, const RenderSettings& settings, Framebuffer& image, AOVBuffer& aovs)
+{
+	const Scene* scenes[] = { &scene };
+	return renderFrame(scenes, [](const auto& f) { f(0); }, settings, image, aovs);
+}
+
+RenderResult render(RenderArenas& arenas, const std::vector<const Scene*>& scenes,
+	const RenderSettings& settings, Framebuffer& image, AOVBuffer& aovs)
+{
+	return renderFrame(scenes.data(), [&](const auto& f) { arenas.executeAll(f); }, settings, image, aovs);
+}
@@ -0,0 +1,60 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "AOV.h"
+#include "Framebuffer.h"
+#include "Scenes.h"
+
+class RenderArenas;
+
+enum class Sampler
+{
+	Random,		// independent uniform jitter for every sample
+	Stratified	// jittered sqrt(spp) x sqrt(spp) grid per pixel, the rest random
+};
+
+struct RenderSettings
+{
+	int image_width = 400;
+	int image_height = 400;
+	int samples_per_pixel = 8;		// per pass when there is a time budget
+	int max_depth = 50;
+	uint32_t seed = 0;
+	int tile_size = 32;				// square tiles, one per task
+	Sampler sampler = Sampler::Random;
+	double time_budget = 0.0;		// seconds; above 0, whole passes repeat until it is spent
+	bool capture_aovs = false;
+	bool show_progress = true;
+};
+
+struct RenderResult
+{
+	double seconds = 0.0;
+	uint64_t rays = 0;				// every ray traced, primary and secondary
+	int passes = 0;
+	int samples_per_pixel = 0;		// over all passes
+};
+
+// spread is the angle a pixel subtends; together with the distance travelled
+// it gives the ray cone width used to pick texture MIP levels. When aov is
+// given it receives the first hit.
+Color ray_color(const Ray& r, const Color& background, const Hittable& world, int depth,
+	double spread = 0.0, double distance = 0.0, AOVSample* aov = nullptr);
+
+// Renders scene into image, and the first pass's AOVs into aovs when
+// settings.capture_aovs, both resized to the settings. Each tile reseeds its
+// thread's generator from the seed, the pass and the tile index, so a seed
+// gives the same image with any number of threads. Tiles are claimed
+// dynamically by the threads of the calling arena.
+RenderResult render(const Scene& scene, const RenderSettings& settings, Framebuffer& image, AOVBuffer& aovs);
+
+// As above, with the tiles claimed by the threads of every arena at once.
+// Threads of arena i trace against scenes[i], so the scenes can be replicas
+// built on each arena's NUMA node, or the same scene repeated.
+RenderResult render(RenderArenas& arenas, const std::vector<const Scene*>& scenes,
+	const RenderSettings& settings, Framebuffer& image, AOVBuffer& aovs);
+
+#endif // !RENDERER_H
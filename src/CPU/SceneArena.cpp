@@ -0,0 +1,56 @@
+#include "SceneArena.h"
+
+#include <cstdint>
+#include <new>
+
+void* SceneArena::allocate(size_t bytes, size_t alignment, Category category)
+{
+	m_bytes[category] += bytes;
+
+	uintptr_t aligned = (reinterpret_cast<uintptr_t>(m_cursor) + alignment - 1) & ~(alignment - 1);
+	if (m_cursor == nullptr || aligned + bytes > reinterpret_cast<uintptr_t>(m_end))
+	{
+		// Oversized requests get a block of their own so the current one stays usable.
+		size_t size = max(m_block_size, bytes + alignment);
+		char* block = static_cast<char*>(::operator new(size));
+		m_blocks.push_back(block);
+		m_reserved += size;
+
+		aligned = (reinterpret_cast<uintptr_t>(block) + alignment - 1) & ~(alignment - 1);
+		if (size == m_block_size || m_cursor == nullptr)
+		{
+			m_cursor = reinterpret_cast<char*>(aligned + bytes);
+			m_end = block + size;
+		}
+		return reinterpret_cast<void*>(aligned);
+	}
+
+	m_cursor = reinterpret_cast<char*>(aligned + bytes);
+	return reinterpret_cast<void*>(aligned);
+}
+
+void SceneArena::reset()
+{
+	for (char* block : m_blocks)
+		::operator delete(block);
+
+	m_blocks.clear();
+	m_cursor = m_end = nullptr;
+	m_reserved = 0;
+	m_material_ids = 0;
+	for (int i = 0; i < CategoryCount; i++)
+		m_bytes[i] = m_objects[i] = 0;
+}
+
+void SceneArena::printStats(std::ostream& out) const
+{
+	const char* names[CategoryCount] = { "hittables", "materials", "textures", "others" };
+
+	out << "Scene arena: " << m_reserved / 1024 << " KiB reserved in " << m_blocks.size() << " blocks\n";
+	for (int i = 0; i < CategoryCount; i++)
+	{
+		if (m_objects[i] == 0)
+			continue;
+		out << "  " << names[i] << ": " << m_objects[i] << " objects, " << m_bytes[i] << " bytes\n";
+	}
+}
@@ -0,0 +1,92 @@
+#ifndef SCENE_ARENA_H
+#define SCENE_ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Material.h"
+
+// Scene-scoped monotonic arena. Objects made through it are placed, together
+// with their shared_ptr control blocks, in a few large contiguous blocks.
+// Destructors still run when the last shared_ptr goes away, but no memory is
+// returned until the arena is reset or destroyed, which frees everything in one
+// go. The arena must outlive every object made from it, and is meant to be
+// filled from a single thread during scene construction. It also numbers the
+// materials it makes (see Material::getID), so IDs are local to the scene.
+class SceneArena
+{
+public:
+	enum Category { Hittables, Materials, Textures, Others, CategoryCount };
+
+	template<typename T>
+	class Allocator
+	{
+	public:
+		using value_type = T;
+
+		Allocator(SceneArena* arena, Category category) : m_arena(arena), m_category(category) {}
+		template<typename U>
+		Allocator(const Allocator<U>& other) : m_arena(other.m_arena), m_category(other.m_category) {}
+
+		T* allocate(size_t n) { return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T), m_category)); }
+		void deallocate(T*, size_t) {}
+
+		template<typename U> bool operator==(const Allocator<U>& rhs) const { return m_arena == rhs.m_arena; }
+		template<typename U> bool operator!=(const Allocator<U>& rhs) const { return m_arena != rhs.m_arena; }
+
+	public:
+		SceneArena* m_arena;
+		Category m_category;
+	};
+
+	explicit SceneArena(size_t block_size = 1 << 20) : m_block_size(block_size) {}
+	~SceneArena() { reset(); }
+
+	SceneArena(const SceneArena&) = delete;
+	SceneArena& operator=(const SceneArena&) = delete;
+
+	template<typename T, typename... Args>
+	shared_ptr<T> make(Args&&... args)
+	{
+		m_objects[categoryOf<T>()]++;
+		shared_ptr<T> object = std::allocate_shared<T>(Allocator<T>(this, categoryOf<T>()), std::forward<Args>(args)...);
+		number(object.get());
+		return object;
+	}
+
+	void* allocate(size_t bytes, size_t alignment, Category category);
+
+	// Releases all blocks at once. Every object must already be destroyed.
+	void reset();
+
+	size_t getBytes(Category category) const { return m_bytes[category]; }
+	size_t getObjectCount(Category category) const { return m_objects[category]; }
+	size_t getReservedBytes() const { return m_reserved; }
+
+	void printStats(std::ostream& out) const;
+
+private:
+	void number(Material* material) { material->m_id = ++m_material_ids; }
+	void number(const void*) {}
+
+	template<typename T>
+	static Category categoryOf()
+	{
+		return std::is_base_of<Hittable, T>::value ? Hittables
+			: std::is_base_of<Material, T>::value ? Materials
+			: std::is_base_of<Texture, T>::value ? Textures
+			: Others;
+	}
+
+private:
+	size_t m_block_size;
+	std::vector<char*> m_blocks;
+	char* m_cursor = nullptr;
+	char* m_end = nullptr;
+	size_t m_reserved = 0;
+	size_t m_bytes[CategoryCount] = {};
+	size_t m_objects[CategoryCount] = {};
+	int m_material_ids = 0;
+};
+
+#endif // !SCENE_ARENA_H
@@ -0,0 +1,1060 @@
+#include "SceneFile.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
+#include <tbb/parallel_for.h>
+
+#include "BVH.h"
+#include "ConstantMedium.h"
+#include "HeterogeneousMedium.h"
+#include "Instance.h"
+#include "MappedFile.h"
+#include "Material.h"
+#include "MeshLoader.h"
+#include "SparseGrid.h"
+#include "SphereSet.h"
+#include "TextureCache.h"
+
+namespace
+{
+	const char scene_magic[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', 0 };
+	const uint32_t scene_version = 1;
+
+	// Target size of one parse task. Chunks are cut at line boundaries.
+	const size_t chunk_bytes = 1 << 20;
+
+	enum class Kind : uint8_t
+	{
+		Camera, Image, Background, Texture, Material,
+		Sphere, MovingSphere, XYRect, XZRect, YZRect, Box, Mesh,
+		Transform, Object, End, Instance, Medium, Bake,
+		Count
+	};
+
+	enum class Variant : uint8_t
+	{
+		None,
+		Solid, Checker, Noise, Image,						// textures
+		Lambertian, Metal, Dielectric, Light, Isotropic,	// materials
+		Constant, Grid,										// media, grid also a bake
+		UVSphere,											// bakes
+		Count
+	};
+
+	template<typename T>
+	struct Keyword
+	{
+		std::string_view text;
+		T value;
+	};
+
+	const Keyword<Kind> kinds[] = {
+		{ "camera", Kind::Camera }, { "image", Kind::Image }, { "background", Kind::Background },
+		{ "texture", Kind::Texture }, { "material", Kind::Material },
+		{ "sphere", Kind::Sphere }, { "moving_sphere", Kind::MovingSphere },
+		{ "xy_rect", Kind::XYRect }, { "xz_rect", Kind::XZRect }, { "yz_rect", Kind::YZRect },
+		{ "box", Kind::Box }, { "mesh", Kind::Mesh },
+		{ "transform", Kind::Transform }, { "object", Kind::Object }, { "end", Kind::End },
+		{ "instance", Kind::Instance }, { "medium", Kind::Medium }, { "bake", Kind::Bake }
+	};
+
+	const Keyword<Variant> textures[] = {
+		{ "solid", Variant::Solid }, { "checker", Variant::Checker }, { "noise", Variant::Noise }, { "image", Variant::Image }
+	};
+
+	const Keyword<Variant> materials[] = {
+		{ "lambertian", Variant::Lambertian }, { "metal", Variant::Metal }, { "dielectric", Variant::Dielectric },
+		{ "light", Variant::Light }, { "isotropic", Variant::Isotropic }
+	};
+
+	const Keyword<Variant> media[] = {
+		{ "constant", Variant::Constant }, { "grid", Variant::Grid }
+	};
+
+	const Keyword<Variant> bakes[] = {
+		{ "grid", Variant::Grid }, { "sphere", Variant::UVSphere }
+	};
+
+	template<typename T, size_t N>
+	bool lookup(const Keyword<T> (&table)[N], std::string_view text, T& value)
+	{
+		for (const Keyword<T>& keyword : table)
+		{
+			if (keyword.text == text)
+			{
+				value = keyword.value;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Text inside the file (text scenes) or the string table (compiled ones).
+	struct StringRef
+	{
+		uint32_t offset;
+		uint32_t length;
+	};
+
+	// One parsed line. Kept trivially copyable, since the compiled form
+	// stores these records as they are.
+	struct Statement
+	{
+		Kind kind;
+		Variant variant;
+		uint16_t value_count;
+		uint32_t line;
+		StringRef name;		// the name being defined
+		StringRef ref;		// the material, texture or object used
+		StringRef path;
+		double values[12];	// a transform keeps its matrix here, row by row
+	};
+
+	static_assert(std::is_trivially_copyable<Statement>::value, "statements are written as raw bytes");
+
+	struct CompiledHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t statement_size;
+		uint64_t statement_count;
+		uint64_t statement_offset;
+		uint64_t string_offset;
+		uint64_t string_size;
+		uint64_t file_size;
+	};
+
+	inline bool isBlank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	// Tokens of one line, as views into the text.
+	class LineParser
+	{
+	public:
+		LineParser(const char* begin, const char* end, const char* base) : m_p(begin), m_end(end), m_base(base) {}
+
+		bool atEnd()
+		{
+			skipBlanks();
+			return m_p == m_end || *m_p == '#';
+		}
+
+		bool token(std::string_view& text)
+		{
+			if (atEnd())
+				return false;
+
+			const char* begin = m_p;
+			while (m_p < m_end && !isBlank(*m_p) && *m_p != '#')
+				m_p++;
+			text = std::string_view(begin, m_p - begin);
+			return true;
+		}
+
+		bool token(StringRef& ref)
+		{
+			std::string_view text;
+			if (!token(text))
+				return false;
+			ref.offset = static_cast<uint32_t>(text.data() - m_base);
+			ref.length = static_cast<uint32_t>(text.size());
+			return true;
+		}
+
+		bool number(double& value)
+		{
+			if (atEnd())
+				return false;
+
+			const char* p = m_p;
+			if (*p == '+')
+				p++;
+			auto result = std::from_chars(p, m_end, value);
+			if (result.ec != std::errc() || (result.ptr < m_end && !isBlank(*result.ptr) && *result.ptr != '#'))
+				return false;
+			m_p = result.ptr;
+			return true;
+		}
+
+		bool numbers(Statement& st, int count)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				if (st.value_count == 12 || !number(st.values[st.value_count]))
+					return false;
+				st.value_count++;
+			}
+			return true;
+		}
+
+		// An rgb color into values, or else a texture name into ref.
+		bool colorOrTexture(Statement& st)
+		{
+			const char* start = m_p;
+			double value;
+			if (number(value))
+			{
+				m_p = start;
+				return numbers(st, 3);
+			}
+			return token(st.ref);
+		}
+
+	private:
+		void skipBlanks()
+		{
+			while (m_p < m_end && isBlank(*m_p))
+				m_p++;
+		}
+
+	private:
+		const char* m_p;
+		const char* m_end;
+		const char* m_base;
+	};
+
+	// Whole numbers in 1..INT_MAX; image sizes and sample counts are ints.
+	inline bool isPositiveInt(double value)
+	{
+		return value >= 1.0 && value <= static_cast<double>(std::numeric_limits<int>::max()) && value == std::floor(value);
+	}
+
+	inline bool isAbsolutePath(std::string_view path)
+	{
+		return !path.empty() && (path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':'));
+	}
+
+	// Composes the operations left to right into a matrix.
+	const char* parseTransform(LineParser& in, Statement& st)
+	{
+		Matrix34 transform;
+		std::string_view op;
+		while (in.token(op))
+		{
+			Statement args = {};
+			if (op == "translate" && in.numbers(args, 3))
+				transform = Matrix34::translation(Vector3(args.values[0], args.values[1], args.values[2])) * transform;
+			else if (op == "rotate" && in.numbers(args, 4))
+				transform = Matrix34::rotation(Vector3(args.values[0], args.values[1], args.values[2]), args.values[3]) * transform;
+			else if (op == "rotate_y" && in.numbers(args, 1))
+				transform = Matrix34::rotationY(args.values[0]) * transform;
+			else if (op == "scale" && in.numbers(args, 3))
+				transform = Matrix34::scaling(Vector3(args.values[0], args.values[1], args.values[2])) * transform;
+			else
+				return "bad transform operation";
+		}
+
+		memcpy(st.values, transform.m, sizeof(transform.m));
+		st.value_count = 12;
+		return nullptr;
+	}
+
+	// Returns an error message, or nullptr once the statement is filled in.
+	const char* parseStatement(LineParser& in, Statement& st)
+	{
+		std::string_view word;
+		in.token(word);
+		if (!lookup(kinds, word, st.kind))
+			return "unknown statement";
+
+		switch (st.kind)
+		{
+		case Kind::Camera:
+			if (!in.numbers(st, 7))
+				return "expected camera position, target and vfov";
+			if (!in.atEnd() && !in.numbers(st, 1))
+				return "bad aperture";
+			break;
+
+		case Kind::Image:
+			if (!in.numbers(st, 3))
+				return "expected width, height and samples per pixel";
+			break;
+
+		case Kind::Background:
+			if (!in.numbers(st, 3))
+				return "expected a color";
+			break;
+
+		case Kind::Texture:
+			if (!in.token(st.name) || !in.token(word) || !lookup(textures, word, st.variant))
+				return "expected a texture name and type";
+			if ((st.variant == Variant::Solid && !in.numbers(st, 3)) ||
+				(st.variant == Variant::Checker && !in.numbers(st, 6)) ||
+				(st.variant == Variant::Noise && !in.numbers(st, 1)) ||
+				(st.variant == Variant::Image && !in.token(st.path)))
+				return "bad texture parameters";
+			break;
+
+		case Kind::Material:
+			if (!in.token(st.name) || !in.token(word) || !lookup(materials, word, st.variant))
+				return "expected a material name and type";
+			if (st.variant == Variant::Metal ? !in.numbers(st, 4)
+				: st.variant == Variant::Dielectric ? !in.numbers(st, 1)
+				: !in.colorOrTexture(st))
+				return "bad material parameters";
+			break;
+
+		case Kind::Sphere:
+		case Kind::MovingSphere:
+		case Kind::XYRect:
+		case Kind::XZRect:
+		case Kind::YZRect:
+		case Kind::Box:
+		{
+			static const int counts[] = { 4, 9, 5, 5, 5, 6 };
+			if (!in.token(st.ref) || !in.numbers(st, counts[static_cast<int>(st.kind) - static_cast<int>(Kind::Sphere)]))
+				return "bad shape parameters";
+			break;
+		}
+
+		case Kind::Mesh:
+			if (!in.token(st.ref) || !in.token(st.path))
+				return "expected a material and a mesh file";
+			break;
+
+		case Kind::Transform:
+			return parseTransform(in, st);
+
+		case Kind::Object:
+			if (!in.token(st.name))
+				return "expected an object name";
+			break;
+
+		case Kind::End:
+			break;
+
+		case Kind::Instance:
+			if (!in.token(st.ref))
+				return "expected an object name";
+			break;
+
+		case Kind::Medium:
+			if (!in.token(st.ref) || !in.token(word) || !lookup(media, word, st.variant))
+				return "expected a boundary object and a medium type";
+			if ((st.variant == Variant::Grid && !in.token(st.path)) || !in.numbers(st, 4))
+				return "bad medium parameters";
+			break;
+
+		case Kind::Bake:
+			if (!in.token(st.ref) || !in.token(word) || !lookup(bakes, word, st.variant))
+				return "expected a texture name and a bake type";
+			if (!in.numbers(st, st.variant == Variant::Grid ? 7 : 6))
+				return "bad bake parameters";
+			break;
+
+		default:
+			break;
+		}
+
+		if (!in.atEnd())
+			return "unexpected text at the end of the line";
+		return nullptr;
+	}
+
+	struct Chunk
+	{
+		std::vector<Statement> statements;
+		uint32_t lines = 0;
+		uint32_t error_line = 0;
+		const char* error = nullptr;
+	};
+
+	// Line numbers are chunk-local here and rebased after the merge.
+	void parseChunk(const char* p, const char* end, const char* base, Chunk& chunk)
+	{
+		chunk.statements.reserve((end - p) / 32);
+
+		while (p < end)
+		{
+			const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+			if (line_end == nullptr)
+				line_end = end;
+			chunk.lines++;
+
+			LineParser in(p, line_end, base);
+			if (!in.atEnd())
+			{
+				Statement st = {};
+				st.line = chunk.lines;
+				const char* error = parseStatement(in, st);
+				if (error)
+				{
+					chunk.error = error;
+					chunk.error_line = chunk.lines;
+					return;
+				}
+				chunk.statements.push_back(st);
+			}
+
+			p = line_end + 1;
+		}
+	}
+
+	bool parseText(const char* filename, const char* data, size_t size, std::vector<Statement>& statements)
+	{
+		if (size > UINT32_MAX)
+		{
+			std::cerr << "Scene file too large->" << filename << std::endl;
+			return false;
+		}
+
+		const char* end = data + size;
+
+		// Split at line boundaries.
+		std::vector<const char*> bounds = { data };
+		while (end - bounds.back() > static_cast<ptrdiff_t>(chunk_bytes))
+		{
+			const char* cut = bounds.back() + chunk_bytes;
+			cut = static_cast<const char*>(memchr(cut, '\n', end - cut));
+			if (cut == nullptr)
+				break;
+			bounds.push_back(cut + 1);
+		}
+		bounds.push_back(end);
+
+		const size_t chunk_count = bounds.size() - 1;
+		std::vector<Chunk> chunks(chunk_count);
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, chunk_count, 1), [&](const tbb::blocked_range<size_t>& r)
+		{
+			for (size_t i = r.begin(); i != r.end(); i++)
+				parseChunk(bounds[i], bounds[i + 1], data, chunks[i]);
+		});
+
+		// Prefix sums give every chunk its first line and its offset into the
+		// merged statements.
+		std::vector<uint32_t> first_line(chunk_count + 1, 0);
+		std::vector<size_t> offsets(chunk_count + 1, 0);
+		for (size_t i = 0; i < chunk_count; i++)
+		{
+			if (chunks[i].error)
+			{
+				std::cerr << "Scene parse error, " << chunks[i].error << " on line "
+					<< first_line[i] + chunks[i].error_line << "->" << filename << std::endl;
+				return false;
+			}
+			first_line[i + 1] = first_line[i] + chunks[i].lines;
+			offsets[i + 1] = offsets[i] + chunks[i].statements.size();
+		}
+
+		statements.resize(offsets[chunk_count]);
+		tbb::parallel_for(tbb::blocked_range<size_t>(0, chunk_count, 1), [&](const tbb::blocked_range<size_t>& r)
+		{
+			for (size_t i = r.begin(); i != r.end(); i++)
+			{
+				Statement* out = statements.data() + offsets[i];
+				for (const Statement& st : chunks[i].statements)
+				{
+					*out = st;
+					out->line += first_line[i];
+					out++;
+				}
+			}
+		});
+
+		return true;
+	}
+
+	// Points statements and strings into a mapped compiled scene after
+	// checking that every record and name lies inside the file.
+	bool attachCompiled(const char* data, size_t size, const Statement*& statements, size_t& count, const char*& strings)
+	{
+		if (size < sizeof(CompiledHeader))
+			return false;
+
+		const CompiledHeader* header = reinterpret_cast<const CompiledHeader*>(data);
+		if (memcmp(header->magic, scene_magic, sizeof(header->magic)) != 0 || header->version != scene_version ||
+			header->statement_size != sizeof(Statement) || header->statement_offset % alignof(Statement) != 0)
+			return false;
+
+		// Offsets are checked before the counts are scaled against what is
+		// left after them, so a crafted header can not wrap around.
+		if (header->file_size != size ||
+			header->statement_offset > size ||
+			header->statement_count > (size - header->statement_offset) / sizeof(Statement) ||
+			header->string_offset > size ||
+			header->string_size > size - header->string_offset)
+			return false;
+
+		statements = reinterpret_cast<const Statement*>(data + header->statement_offset);
+		count = static_cast<size_t>(header->statement_count);
+		strings = data + header->string_offset;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const Statement& st = statements[i];
+			if (st.kind >= Kind::Count || st.variant >= Variant::Count || st.value_count > 12)
+				return false;
+			for (const StringRef* ref : { &st.name, &st.ref, &st.path })
+			{
+				if (static_cast<uint64_t>(ref->offset) + ref->length > header->string_size)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// Turns statements into the scene. Runs on one thread, in file order, since
+	// names must be defined before they are used.
+	class SceneBuilder
+	{
+	public:
+		SceneBuilder(const char* filename, const char* strings, SceneArena& arena, Scene& scene)
+			: m_filename(filename), m_strings(strings), m_arena(arena), m_scene(scene)
+		{
+			const char* slash = strrchr(filename, '/');
+			const char* backslash = strrchr(filename, '\\');
+			if (backslash > slash)
+				slash = backslash;
+			if (slash)
+				m_directory.assign(filename, slash + 1);
+		}
+
+		bool build(const Statement* statements, size_t count)
+		{
+			// Decode images in the background while the geometry is built.
+			for (size_t i = 0; i < count; i++)
+			{
+				if (statements[i].kind == Kind::Texture && statements[i].variant == Variant::Image)
+					TextureCache::instance().prefetch(getPath(statements[i].path));
+			}
+
+			bool has_camera = false;
+			for (size_t i = 0; i < count; i++)
+			{
+				const Statement& st = statements[i];
+				has_camera |= st.kind == Kind::Camera;
+				if (!apply(st))
+					return false;
+			}
+
+			if (m_block != &m_top)
+			{
+				std::cerr << "Object '" << m_object.name << "' has no end->" << m_filename << std::endl;
+				return false;
+			}
+			if (!has_camera)
+			{
+				std::cerr << "Scene has no camera->" << m_filename << std::endl;
+				return false;
+			}
+
+			m_scene.world.clear();
+			if (auto top = finish(m_top))
+				m_scene.world.add(top);
+			if (m_instances)
+			{
+				m_instances->build(0.0, 1.0);
+				m_scene.world.add(m_instances);
+			}
+			return true;
+		}
+
+	private:
+		// Blocks with more shapes than this get a BVH.
+		static const size_t max_flat_block = 8;
+
+		// Bakes are held in memory whole: at most 256^3 grid nodes (200 MB) or an
+		// 8192^2 sphere map.
+		static constexpr double max_bake_resolution = 256;
+		static constexpr double max_bake_size = 8192;
+
+		// Shapes and placements of the top level or of one object.
+		struct Block
+		{
+			HittableList objects;
+			SphereSet spheres;		// untransformed spheres, as flat arrays
+			std::unordered_map<const Material*, uint32_t> sphere_materials;
+			Matrix34 transform;
+			bool transformed = false;
+			std::string_view name;
+		};
+
+		bool apply(const Statement& st)
+		{
+			const double* v = st.values;
+			Block& block = *m_block;
+
+			switch (st.kind)
+			{
+			case Kind::Camera:
+			{
+				const Point3 lookfrom(v[0], v[1], v[2]);
+				const Point3 lookat(v[3], v[4], v[5]);
+				const double aperture = st.value_count > 7 ? v[7] : 0.0;
+				if (!(v[6] > 0.0 && v[6] < 180.0))
+					return fail(st, "Camera vfov must be between 0 and 180 degrees");
+				if (!(aperture >= 0.0 && std::isfinite(aperture)))
+					return fail(st, "Camera aperture must not be negative");
+				// The camera's up vector is +y, so it can not look along it.
+				const Vector3 view = lookfrom - lookat;
+				if (!std::isfinite(view.getLength()) || equal(view.crossProduct(Vector3(0, 1, 0)).getLength(), 0.0))
+					return fail(st, "Camera target must differ from its position and not be straight above or below it");
+				m_scene.lookfrom = lookfrom;
+				m_scene.lookat = lookat;
+				m_scene.vfov = v[6];
+				m_scene.aperture = aperture;
+				return true;
+			}
+
+			case Kind::Image:
+				if (!isPositiveInt(v[0]) || !isPositiveInt(v[1]) || !isPositiveInt(v[2]))
+					return fail(st, "Image width, height and samples per pixel must be positive integers");
+				m_scene.image_width = static_cast<int>(v[0]);
+				m_scene.image_height = static_cast<int>(v[1]);
+				m_scene.samples_per_pixel = static_cast<int>(v[2]);
+				return true;
+
+			case Kind::Background:
+				m_scene.background = Color(v[0], v[1], v[2]);
+				return true;
+
+			case Kind::Texture:
+			{
+				shared_ptr<Texture> texture;
+				if (st.variant == Variant::Solid)
+					texture = m_arena.make<SolidColor>(Color(v[0], v[1], v[2]));
+				else if (st.variant == Variant::Checker)
+					texture = m_arena.make<CheckerTexture>(Color(v[0], v[1], v[2]), Color(v[3], v[4], v[5]));
+				else if (st.variant == Variant::Noise)
+					texture = m_arena.make<NoiseTexture>(v[0]);
+				else
+					texture = m_arena.make<ImageTexture>(getPath(st.path).c_str());
+				m_textures[getText(st.name)] = texture;
+				return true;
+			}
+
+			case Kind::Material:
+			{
+				shared_ptr<Material> material;
+				if (st.variant == Variant::Metal)
+				{
+					material = m_arena.make<Metal>(Color(v[0], v[1], v[2]), v[3]);
+				}
+				else if (st.variant == Variant::Dielectric)
+				{
+					material = m_arena.make<Dielectric>(v[0]);
+				}
+				else
+				{
+					shared_ptr<Texture> texture = getColorTexture(st);
+					if (!texture)
+						return false;
+					if (st.variant == Variant::Lambertian)
+						material = m_arena.make<Lambertian>(texture);
+					else if (st.variant == Variant::Light)
+						material = m_arena.make<DiffuseLight>(texture);
+					else
+						material = m_arena.make<Isotropic>(texture);
+				}
+				m_materials[getText(st.name)] = material;
+				return true;
+			}
+
+			case Kind::Sphere:
+			case Kind::MovingSphere:
+			case Kind::XYRect:
+			case Kind::XZRect:
+			case Kind::YZRect:
+			case Kind::Box:
+			case Kind::Mesh:
+				return addShape(st);
+
+			case Kind::Transform:
+			{
+				Matrix34 transform;
+				memcpy(transform.m, v, sizeof(transform.m));
+				if (transform.isSingular() || !std::isfinite(transform.getTranslation().getLength()))
+					return fail(st, "Transform is not invertible");
+				block.transform = transform;
+				block.transformed = !block.transform.isIdentity();
+				return true;
+			}
+
+			case Kind::Object:
+				if (m_block != &m_top)
+					return fail(st, "Objects can not be nested");
+				m_object = Block();
+				m_object.name = getText(st.name);
+				m_block = &m_object;
+				return true;
+
+			case Kind::End:
+			{
+				if (m_block == &m_top)
+					return fail(st, "End without object");
+				shared_ptr<Hittable> object = finish(m_object);
+				if (!object)
+					return fail(st, "Empty object", m_object.name);
+				m_objects[m_object.name] = object;
+				m_blas.erase(m_object.name);
+				m_block = &m_top;
+				return true;
+			}
+
+			case Kind::Instance:
+			{
+				if (m_block != &m_top)
+					return fail(st, "Instances must be placed at the top level");
+				shared_ptr<Hittable> object = getObject(st);
+				if (!object)
+					return false;
+
+				if (!m_instances)
+					m_instances = m_arena.make<TLAS>();
+
+				// One BLAS per object, shared by all of its placements.
+				auto blas = m_blas.find(getText(st.ref));
+				if (blas == m_blas.end())
+					blas = m_blas.emplace(getText(st.ref), m_instances->addBLAS(object)).first;
+				m_instances->addInstance(blas->second, block.transform);
+				return true;
+			}
+
+			case Kind::Medium:
+			{
+				if (!(v[0] > 0.0 && std::isfinite(v[0])))
+					return fail(st, "Medium density must be positive");
+				shared_ptr<Hittable> boundary = getObject(st);
+				if (!boundary)
+					return false;
+				boundary = place(boundary);
+				if (!boundary)
+					return fail(st, "Transform is not invertible combined with the object's own", getText(st.ref));
+
+				if (st.variant == Variant::Constant)
+				{
+					block.objects.add(m_arena.make<ConstantMedium>(boundary, v[0], m_arena.make<Isotropic>(Color(v[1], v[2], v[3]))));
+					return true;
+				}
+
+				shared_ptr<SparseGrid> density = SparseGrid::load(getPath(st.path).c_str());
+				if (!density)
+					return fail(st, "Could not load the density grid");
+				block.objects.add(m_arena.make<HeterogeneousMedium>(boundary, density, v[0], m_arena.make<Isotropic>(Color(v[1], v[2], v[3]))));
+				return true;
+			}
+
+			case Kind::Bake:
+			{
+				auto texture = m_textures.find(getText(st.ref));
+				if (texture == m_textures.end())
+					return fail(st, "Unknown texture", getText(st.ref));
+				if (!std::dynamic_pointer_cast<NoiseTexture>(texture->second) && !std::dynamic_pointer_cast<CheckerTexture>(texture->second))
+					return fail(st, "Only checker and noise textures can be baked", getText(st.ref));
+
+				if (st.variant == Variant::Grid)
+				{
+					const Point3 lo(v[1], v[2], v[3]);
+					const Point3 hi(v[4], v[5], v[6]);
+					if (!isPositiveInt(v[0]) || v[0] > max_bake_resolution)
+						return fail(st, "Bake resolution must be a positive integer up to 256");
+					if (!(lo.x <= hi.x && lo.y <= hi.y && lo.z <= hi.z) || !std::isfinite((hi - lo).getLength()))
+						return fail(st, "Bake bounds must be finite with min <= max");
+					texture->second = m_arena.make<BakedTexture>(texture->second, AABB(lo, hi), static_cast<int>(v[0]));
+					return true;
+				}
+
+				if (!isPositiveInt(v[0]) || !isPositiveInt(v[1]) || v[0] > max_bake_size || v[1] > max_bake_size)
+					return fail(st, "Bake width and height must be positive integers up to 8192");
+				const Point3 center(v[2], v[3], v[4]);
+				const double radius = v[5];
+				if (!(radius > 0.0 && std::isfinite(radius)))
+					return fail(st, "Bake sphere radius must be positive");
+				texture->second = m_arena.make<BakedTexture>(texture->second, static_cast<int>(v[0]), static_cast<int>(v[1]),
+					[center, radius](double u, double v) { return center + radius * Sphere::getSpherePoint(u, v); });
+				return true;
+			}
+
+			default:
+				return fail(st, "Unknown statement");
+			}
+		}
+
+		bool addShape(const Statement& st)
+		{
+			const double* v = st.values;
+			Block& block = *m_block;
+
+			shared_ptr<Material> material = getMaterial(st);
+			if (!material)
+				return false;
+
+			shared_ptr<Hittable> shape;
+			switch (st.kind)
+			{
+			case Kind::Sphere:
+				if (!block.transformed)
+				{
+					auto id = block.sphere_materials.find(material.get());
+					if (id == block.sphere_materials.end())
+						id = block.sphere_materials.emplace(material.get(), block.spheres.addMaterial(material)).first;
+					block.spheres.add(Point3(v[0], v[1], v[2]), v[3], id->second);
+					return true;
+				}
+				shape = m_arena.make<Sphere>(Point3(v[0], v[1], v[2]), v[3], material);
+				break;
+
+			case Kind::MovingSphere:
+				shape = m_arena.make<MovingSphere>(Point3(v[0], v[1], v[2]), Point3(v[3], v[4], v[5]), v[6], v[7], v[8], material);
+				break;
+
+			case Kind::XYRect:
+				shape = m_arena.make<XYRect>(v[0], v[1], v[2], v[3], v[4], material);
+				break;
+
+			case Kind::XZRect:
+				shape = m_arena.make<XZRect>(v[0], v[1], v[2], v[3], v[4], material);
+				break;
+
+			case Kind::YZRect:
+				shape = m_arena.make<YZRect>(v[0], v[1], v[2], v[3], v[4], material);
+				break;
+
+			case Kind::Box:
+				shape = m_arena.make<Box>(Point3(v[0], v[1], v[2]), Point3(v[3], v[4], v[5]), material);
+				break;
+
+			default:
+			{
+				shared_ptr<MeshData> mesh = loadMesh(getPath(st.path).c_str());
+				if (!mesh)
+					return fail(st, "Could not load the mesh");
+				shape = m_arena.make<TriangleMesh>(mesh, material);
+				break;
+			}
+			}
+
+			block.objects.add(place(shape));
+			return true;
+		}
+
+		// Applies the current transform, if any. Returns null when it folds with
+		// the shape's own transform into a singular matrix.
+		shared_ptr<Hittable> place(shared_ptr<Hittable> shape)
+		{
+			if (!m_block->transformed)
+				return shape;
+			if (auto inner = std::dynamic_pointer_cast<Transform>(shape))
+			{
+				if ((m_block->transform * inner->m_placement.to_world).isSingular())
+					return nullptr;
+			}
+			return m_arena.make<Transform>(shape, m_block->transform);
+		}
+
+		// One hittable for the whole block: its single shape, a flat list when
+		// there are only a few (large shapes like the Cornell walls overlap
+		// every BVH split, so the tree only adds box tests), or a BVH.
+		shared_ptr<Hittable> finish(Block& block)
+		{
+			if (block.spheres.getSize() > 0)
+				block.objects.add(SphereSet::buildBVH(block.spheres, 0.0, 1.0, 8, &m_arena));
+
+			if (block.objects.isEmpty())
+				return nullptr;
+			if (block.objects.m_list.size() == 1)
+				return block.objects.m_list.front();
+			if (block.objects.m_list.size() <= max_flat_block)
+				return m_arena.make<HittableList>(block.objects);
+			return m_arena.make<BVHNode>(block.objects, 0.0, 1.0, &m_arena);
+		}
+
+		shared_ptr<Texture> getColorTexture(const Statement& st)
+		{
+			if (st.ref.length == 0)
+				return m_arena.make<SolidColor>(Color(st.values[0], st.values[1], st.values[2]));
+
+			auto texture = m_textures.find(getText(st.ref));
+			if (texture == m_textures.end())
+			{
+				fail(st, "Unknown texture", getText(st.ref));
+				return nullptr;
+			}
+			return texture->second;
+		}
+
+		shared_ptr<Material> getMaterial(const Statement& st)
+		{
+			auto material = m_materials.find(getText(st.ref));
+			if (material == m_materials.end())
+			{
+				fail(st, "Unknown material", getText(st.ref));
+				return nullptr;
+			}
+			return material->second;
+		}
+
+		shared_ptr<Hittable> getObject(const Statement& st)
+		{
+			auto object = m_objects.find(getText(st.ref));
+			if (object == m_objects.end())
+			{
+				fail(st, "Unknown object", getText(st.ref));
+				return nullptr;
+			}
+			return object->second;
+		}
+
+		std::string_view getText(const StringRef& ref) const
+		{
+			return std::string_view(m_strings + ref.offset, ref.length);
+		}
+
+		// Paths are relative to the scene file unless absolute.
+		std::string getPath(const StringRef& ref) const
+		{
+			std::string_view path = getText(ref);
+			return isAbsolutePath(path) ? std::string(path) : m_directory + std::string(path);
+		}
+
+		bool fail(const Statement& st, const char* message, std::string_view name = std::string_view())
+		{
+			std::cerr << message;
+			if (!name.empty())
+				std::cerr << " '" << name << "'";
+			std::cerr << " on line " << st.line << "->" << m_filename << std::endl;
+			return false;
+		}
+
+	private:
+		const char* m_filename;
+		const char* m_strings;
+		std::string m_directory;
+		SceneArena& m_arena;
+		Scene& m_scene;
+
+		Block m_top;
+		Block m_object;
+		Block* m_block = &m_top;
+
+		std::unordered_map<std::string_view, shared_ptr<Texture>> m_textures;
+		std::unordered_map<std::string_view, shared_ptr<Material>> m_materials;
+		std::unordered_map<std::string_view, shared_ptr<Hittable>> m_objects;
+		std::unordered_map<std::string_view, uint32_t> m_blas;
+		shared_ptr<TLAS> m_instances;
+	};
+}
+
+bool loadScene(const char* filename, SceneArena& arena, Scene& scene)
+{
+	MappedFile file(filename);
+	if (!file.isOpen())
+		return false;
+
+	const char* data = file.getData();
+	const size_t size = file.getSize();
+
+	if (size >= sizeof(scene_magic) && memcmp(data, scene_magic, sizeof(scene_magic)) == 0)
+	{
+		const Statement* statements;
+		size_t count;
+		const char* strings;
+		if (!attachCompiled(data, size, statements, count, strings))
+		{
+			std::cerr << "Invalid compiled scene file->" << filename << std::endl;
+			return false;
+		}
+		return SceneBuilder(filename, strings, arena, scene).build(statements, count);
+	}
+
+	std::vector<Statement> statements;
+	if (!parseText(filename, data, size, statements))
+		return false;
+	return SceneBuilder(filename, data, arena, scene).build(statements.data(), statements.size());
+}
+
+bool compileScene(const char* input, const char* output)
+{
+	MappedFile file(input);
+	if (!file.isOpen())
+		return false;
+
+	const char* data = file.getData();
+	const size_t size = file.getSize();
+	if (size >= sizeof(scene_magic) && memcmp(data, scene_magic, sizeof(scene_magic)) == 0)
+	{
+		std::cerr << "Scene file is already compiled->" << input << std::endl;
+		return false;
+	}
+
+	std::vector<Statement> statements;
+	if (!parseText(input, data, size, statements))
+		return false;
+
+	// Every distinct name is stored once.
+	std::string strings;
+	std::unordered_map<std::string, uint32_t> offsets;
+	auto intern = [&](StringRef& ref, std::string_view text)
+	{
+		if (text.empty())
+		{
+			ref.offset = 0;
+			ref.length = 0;
+			return;
+		}
+
+		auto offset = offsets.find(std::string(text));
+		if (offset == offsets.end())
+		{
+			offset = offsets.emplace(std::string(text), static_cast<uint32_t>(strings.size())).first;
+			strings.append(text.data(), text.size());
+		}
+		ref.offset = offset->second;
+		ref.length = static_cast<uint32_t>(text.size());
+	};
+
+	// The compiled scene resolves paths against its own directory, so
+	// relative paths are rebased from the input's directory to the output's.
+	const std::filesystem::path input_dir = std::filesystem::absolute(std::filesystem::path(input)).parent_path();
+	const std::filesystem::path output_dir = std::filesystem::absolute(std::filesystem::path(output)).parent_path();
+	auto rebase = [&](std::string_view path)
+	{
+		if (path.empty() || isAbsolutePath(path))
+			return std::string(path);
+
+		std::error_code error;
+		const std::filesystem::path source = (input_dir / std::filesystem::path(path)).lexically_normal();
+		std::filesystem::path relative = std::filesystem::relative(source, output_dir, error);
+		return (error || relative.empty() ? source : relative).generic_string();
+	};
+
+	for (Statement& st : statements)
+	{
+		intern(st.name, std::string_view(data + st.name.offset, st.name.length));
+		intern(st.ref, std::string_view(data + st.ref.offset, st.ref.length));
+		intern(st.path, rebase(std::string_view(data + st.path.offset, st.path.length)));
+	}
+
+	CompiledHeader header = {};
+	memcpy(header.magic, scene_magic, sizeof(header.magic));
+	header.version = scene_version;
+	header.statement_size = sizeof(Statement);
+	header.statement_count = statements.size();
+	header.statement_offset = sizeof(CompiledHeader);
+	header.string_offset = header.statement_offset + statements.size() * sizeof(Statement);
+	header.string_size = strings.size();
+	header.file_size = header.string_offset + header.string_size;
+
+	std::ofstream out(output, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(statements.data()), statements.size() * sizeof(Statement));
+	out.write(strings.data(), strings.size());
+	if (!out)
+	{
+		std::cerr << "Could not write compiled scene->" << output << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,59 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include "Scenes.h"
+
+// Scene description files. The text form (.rtscene) has one statement per
+// line, '#' starts a comment, and names refer to earlier definitions:
+//
+//   camera <from xyz> <at xyz> <vfov> [aperture]
+//   image <width> <height> <spp>
+//   background <rgb>
+//   texture <name> solid <rgb> | checker <rgb> <rgb> | noise <scale> | image <path>
+//   material <name> lambertian|light|isotropic <rgb or texture>
+//   material <name> metal <rgb> <fuzz> | dielectric <ior>
+//   sphere <material> <center xyz> <radius>
+//   moving_sphere <material> <center0 xyz> <center1 xyz> <t0> <t1> <radius>
+//   xy_rect|xz_rect|yz_rect <material> <a0> <a1> <b0> <b1> <k>
+//   box <material> <min xyz> <max xyz>
+//   mesh <material> <obj or ply path>
+//   transform [translate <xyz>] [rotate <axis xyz> <degrees>] [rotate_y <degrees>] [scale <xyz>] ...
+//   object <name> ... end
+//   instance <object>
+//   medium <object> constant <density> <rgb>
+//   medium <object> grid <rtvol path> <density scale> <rgb>
+//   bake <texture> grid <resolution> <min xyz> <max xyz>
+//   bake <texture> sphere <width> <height> <center xyz> <radius>
+//
+// transform sets the placement of the shapes, instances and media that
+// follow it in the same object (or at the top level); its operations apply
+// in the order written, and a bare transform resets it. Shapes inside
+// object ... end are gathered into one named object, which is not rendered
+// itself but placed by instance (sharing one BVH between all placements)
+// or used as the boundary of a medium. Image sizes and sample counts are
+// positive integers, medium densities are positive, and transforms must be
+// invertible. Paths are relative to the file.
+//
+// bake is opt-in: it replaces a checker or noise texture with a precomputed
+// copy (see BakedTexture) for the materials defined after it, either as a 3D
+// grid of resolution cells along its longest side or as a UV map of a sphere
+// that uses the texture.
+//
+// Lines are parsed in parallel chunks into flat, fixed-size statement
+// records whose names point back into the mapped file, so parsing allocates
+// nothing per token. The compiled form (.rtsb) stores those records and a
+// string table as they are in memory, so loading it maps the file and goes
+// straight to building the scene. Its relative paths are rewritten at
+// compile time to be relative to the .rtsb file, so it can be written to
+// any directory.
+
+// Loads a text or compiled scene (told apart by the file's magic bytes) into
+// arena, which must outlive the scene. Returns false and reports to
+// std::cerr on failure.
+bool loadScene(const char* filename, SceneArena& arena, Scene& scene);
+
+// Parses a text scene and writes its compiled form. Returns false and
+// reports to std::cerr on failure.
+bool compileScene(const char* input, const char* output);
+
+#endif // !SCENE_FILE_H
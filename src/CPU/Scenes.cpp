@@ -0,0 +1,415 @@
+#include "Scenes.h"
+
+#include "BVH.h"
+#include "ConstantMedium.h"
+#include "HeterogeneousMedium.h"
+#include "Instance.h"
+#include "Material.h"
+#include "SparseGrid.h"
+#include "SphereSet.h"
+
+HittableList random_scene(SceneArena& arena)
+{
+	HittableList world;
+
+	// auto ground_material = make_shared<Lambertian>(Color(0.5, 0.5, 0.5));
+	// world.add(make_shared<Sphere>(Point3(0, -1000, 0), 1000, ground_material));
+	auto checker = arena.make<CheckerTexture>(Color(0.2, 0.5, 0.3), Color(0.9, 0.9, 0.3));
+	world.add(arena.make<Sphere>(Point3(0, -1000, 0), 1000, arena.make<Lambertian>(checker)));
+
+	SphereSet spheres;
+	for (int a = -11; a < 11; a++) {
+		for (int b = -11; b < 11; b++) {
+			auto choose_mat = random_double();
+			Point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+
+			if ((center - Point3(4, 0.2, 0)).getLength() > 0.9) {
+				shared_ptr<Material> sphere_material;
+
+				if (choose_mat < 0.8) {
+					// diffuse
+					auto albedo = Color::random() * Color::random();
+					sphere_material = arena.make<Lambertian>(albedo);
+					auto center2 = center + Vector3(0, random_double(0, 0.5), 0);
+					world.add(arena.make<MovingSphere>(center, center2, 0.0, 1.0, 0.2, sphere_material));
+				}
+				else if (choose_mat < 0.95) {
+					// metal
+					auto albedo = Color::random(0.5, 1);
+					auto fuzz = random_double(0, 0.5);
+					sphere_material = arena.make<Metal>(albedo, fuzz);
+					spheres.add(center, 0.2, sphere_material);
+				}
+				else {
+					// glass
+					sphere_material = arena.make<Dielectric>(1.5);
+					spheres.add(center, 0.2, sphere_material);
+				}
+			}
+		}
+	}
+
+	auto material1 = arena.make<Dielectric>(1.5);
+	spheres.add(Point3(0, 1, 0), 1.0, material1);
+
+	auto material2 = arena.make<Lambertian>(Color(0.4, 0.2, 0.1));
+	spheres.add(Point3(-4, 1, 0), 1.0, material2);
+
+	auto material3 = arena.make<Metal>(Color(0.7, 0.6, 0.5), 0.0);
+	spheres.add(Point3(4, 1, 0), 1.0, material3);
+
+	world.add(SphereSet::buildBVH(spheres, 0.0, 1.0, 8, &arena));
+
+	return world;
+}
+
+HittableList two_spheres(SceneArena& arena)
+{
+	HittableList objects;
+
+	auto checker = arena.make<CheckerTexture>(Color(0.2, 0.5, 0.3), Color(0.9, 0.9, 0.3));
+
+	objects.add(arena.make<Sphere>(Point3(0, -10, 0), 10, arena.make<Lambertian>(checker)));
+	objects.add(arena.make<Sphere>(Point3(0,  10, 0), 10, arena.make<Lambertian>(checker)));
+
+	return objects;
+}
+
+HittableList two_perlin_spheres(SceneArena& arena)
+{
+	HittableList objects;
+
+	auto pertext = arena.make<NoiseTexture>(4);
+	objects.add(arena.make<Sphere>(Point3(0, -1000, 0), 1000, arena.make<Lambertian>(pertext)));
+	objects.add(arena.make<Sphere>(Point3(0, 2, 0), 2, arena.make<Lambertian>(pertext)));
+
+	return objects;
+}
+
+HittableList earth(SceneArena& arena)
+{
+	TextureCache::instance().prefetch("../RayTracer/res/earthmap.jpg");
+
+	auto earth_texture = arena.make<ImageTexture>("../RayTracer/res/earthmap.jpg");
+	auto earth_surface = arena.make<Lambertian>(earth_texture);
+	auto globe = arena.make<Sphere>(Point3(0, 0, 0), 2, earth_surface);
+	
+	return HittableList(globe);
+}
+
+HittableList simple_light(SceneArena& arena)
+{
+	HittableList objects;
+
+	auto pertext = arena.make<NoiseTexture>(4);
+	objects.add(arena.make<Sphere>(Point3(0, -1000, 0), 1000, arena.make<Lambertian>(pertext)));
+	objects.add(arena.make<Sphere>(Point3(0, 2, 0), 2, arena.make<Lambertian>(pertext)));
+
+	auto difflight = arena.make<DiffuseLight>(Color(4, 4, 4));
+	objects.add(arena.make<XYRect>(3, 5, 1, 3, -2, difflight));
+
+	return objects;
+}
+
+HittableList cornell_box(SceneArena& arena)
+{
+	HittableList objects;
+
+	auto red   = arena.make<Lambertian>(Color(.65, .05, .05));
+	auto white = arena.make<Lambertian>(Color(.73, .73, .73));
+	auto green = arena.make<Lambertian>(Color(.12, .45, .15));
+	auto light = arena.make<DiffuseLight>(Color(15, 15, 15));
+
+	objects.add(arena.make<YZRect>(0, 555, 0, 555, 555, green));
+	objects.add(arena.make<YZRect>(0, 555, 0, 555, 0, red));
+	objects.add(arena.make<XZRect>(213, 343, 227, 332, 554, light));
+	objects.add(arena.make<XZRect>(0, 555, 0, 555, 0, white));
+	objects.add(arena.make<XZRect>(0, 555, 0, 555, 555, white));
+	objects.add(arena.make<XYRect>(0, 555, 0, 555, 555, white));
+
+	shared_ptr<Hittable> box1 = arena.make<Box>(Point3(0, 0, 0), Point3(165, 330, 165), white);
+	box1 = arena.make<RotateY>(box1, 15);
+	box1 = arena.make<Translate>(box1, Vector3(265, 0, 295));
+	objects.add(box1);
+
+	shared_ptr<Hittable> box2 = arena.make<Box>(Point3(0, 0, 0), Point3(165, 165, 165), white);
+	box2 = arena.make<RotateY>(box2, -18);
+	box2 = arena.make<Translate>(box2, Vector3(130, 0, 65));
+	objects.add(box2);
+
+	return objects;
+}
+
+HittableList cornell_smoke(SceneArena& arena)
+{
+	HittableList objects;
+
+	auto red = arena.make<Lambertian>(Color(.65, .05, .05));
+	auto white = arena.make<Lambertian>(Color(.73, .73, .73));
+	auto green = arena.make<Lambertian>(Color(.12, .45, .15));
+	auto light = arena.make<DiffuseLight>(Color(7, 7, 7));
+
+	objects.add(arena.make<YZRect>(0, 555, 0, 555, 555, green));
+	objects.add(arena.make<YZRect>(0, 555, 0, 555, 0, red));
+	objects.add(arena.make<XZRect>(213, 343, 227, 332, 554, light));
+	objects.add(arena.make<XZRect>(0, 555, 0, 555, 0, white));
+	objects.add(arena.make<XZRect>(0, 555, 0, 555, 555, white));
+	objects.add(arena.make<XYRect>(0, 555, 0, 555, 555, white));
+
+	shared_ptr<Hittable> box1 = arena.make<Box>(Point3(0, 0, 0), Point3(165, 330, 165), white);
+	box1 = arena.make<RotateY>(box1, 15);
+	box1 = arena.make<Translate>(box1, Vector3(265, 0, 295));
+
+	shared_ptr<Hittable> box2 = arena.make<Box>(Point3(0, 0, 0), Point3(165, 165, 165), white);
+	box2 = arena.make<RotateY>(box2, -18);
+	box2 = arena.make<Translate>(box2, Vector3(130, 0, 65));
+
+	objects.add(arena.make<ConstantMedium>(box1, 0.01, arena.make<Isotropic>(Color(0, 0, 0))));
+	objects.add(arena.make<ConstantMedium>(box2, 0.01, arena.make<Isotropic>(Color(1, 1, 1))));
+
+	return objects;
+}
+
+SparseGrid::BatchDensity cloudDensity(AABB& bounds)
+{
+	// Turbulent blob of smoke, empty towards the corners of its box.
+	const Point3 center(278, 250, 278);
+	const double radius = 180.0;
+	auto noise = make_shared<Perlin>();
+	bounds = AABB(center - Vector3(radius, radius, radius), center + Vector3(radius, radius, radius));
+	return [=](const Point3* p, double* out, size_t n)
+	{
+		// The noise of a whole batch goes through Perlin's batch turb.
+		const size_t chunk = 64;
+		Point3 scaled[chunk];
+		for (size_t begin = 0; begin < n; begin += chunk)
+		{
+			const size_t count = min(chunk, n - begin);
+			for (size_t i = 0; i < count; i++)
+				scaled[i] = p[begin + i] * 0.02;
+			noise->turb(scaled, out + begin, count);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				double falloff = 1.0 - (p[begin + i] - center).getLength() / radius;
+				out[begin + i] = fmax(0.0, falloff + 0.6 * out[begin + i] - 0.3);
+			}
+		}
+	};
+}
+
+HittableList cornell_cloud(SceneArena& arena)
+{
+	HittableList objects;
+
+	auto red = arena.make<Lambertian>(Color(.65, .05, .05));
+	auto white = arena.make<Lambertian>(Color(.73, .73, .73));
+	auto green = arena.make<Lambertian>(Color(.12, .45, .15));
+	auto light = arena.make<DiffuseLight>(Color(7, 7, 7));
+
+	objects.add(arena.make<YZRect>(0, 555, 0, 555, 555, green));
+	objects.add(arena.make<YZRect>(0, 555, 0, 555, 0, red));
+	objects.add(arena.make<XZRect>(213, 343, 227, 332, 554, light));
+	objects.add(arena.make<XZRect>(0, 555, 0, 555, 0, white));
+	objects.add(arena.make<XZRect>(0, 555, 0, 555, 555, white));
+	objects.add(arena.make<XYRect>(0, 555, 0, 555, 555, white));
+
+	AABB bounds;
+	auto cloud = cloudDensity(bounds);
+	auto density = arena.make<SparseGrid>(bounds, cloud_voxel_size, cloud);
+
+	auto boundary = arena.make<Box>(bounds.getMin(), bounds.getMax(), white);
+	objects.add(arena.make<HeterogeneousMedium>(boundary, density, 0.05, arena.make<Isotropic>(Color(0.8, 0.8, 0.8))));
+
+	return objects;
+}
+
+HittableList final_scene(SceneArena& arena)
+{
+	// Decode in the background while the geometry is built.
+	TextureCache::instance().prefetch("../../RayTracer/res/earthmap.jpg");
+
+	HittableList boxes1;
+	auto ground = arena.make<Lambertian>(Color(0.48, 0.83, 0.53));
+
+	const int boxes_per_side = 20;
+	for (int i = 0; i < boxes_per_side; i++)
+	{
+		for (int j = 0; j < boxes_per_side; j++)
+		{
+			auto w = 100.0;
+			auto x0 = -1000.0 + i * w;
+			auto z0 = -1000.0 + j * w;
+			auto y0 = 0.0;
+			auto x1 = x0 + w;
+			auto z1 = z0 + w;
+			auto y1 = random_double(1, 101);
+
+			boxes1.add(arena.make<Box>(Point3(x0, y0, z0), Point3(x1, y1, z1), ground));
+		}
+	}
+
+	HittableList objects;
+
+	objects.add(arena.make<BVHNode>(boxes1, 0, 1, &arena));
+
+	auto light = arena.make<DiffuseLight>(Color(7, 7, 7));
+	objects.add(arena.make<XZRect>(123, 423, 147, 412, 554, light));
+	
+	auto center1 = Point3(400, 400, 200);
+	auto center2 = center1 + Vector3(30, 0, 0);
+	auto moving_sphere_material = arena.make<Lambertian>(Color(0.7, 0.3, 0.1));
+	objects.add(arena.make<MovingSphere>(center1, center2, 0, 1, 50, moving_sphere_material));
+
+	objects.add(arena.make<Sphere>(Point3(260, 150, 45), 50, arena.make<Dielectric>(1.5)));
+	objects.add(arena.make<Sphere>(Point3(0, 150, 145), 50, arena.make<Metal>(Color(0.8, 0.8, 0.9), 10.0)));
+
+	auto boundary = arena.make<Sphere>(Point3(360, 150, 145), 70, arena.make<Dielectric>(1.5));
+	objects.add(boundary);
+	objects.add(arena.make<ConstantMedium>(boundary, 0.2, arena.make<Isotropic>(Color(0.2, 0.4, 0.9))));
+	boundary = arena.make<Sphere>(Point3(0, 0, 0), 5000, arena.make<Dielectric>(1.5));
+	objects.add(arena.make<ConstantMedium>(boundary, .0001, arena.make<Isotropic>(Color(1, 1, 1))));
+
+	auto emat = arena.make<Lambertian>(arena.make<ImageTexture>("../../RayTracer/res/earthmap.jpg"));
+	objects.add(arena.make<Sphere>(Point3(400, 200, 400), 100, emat));
+	auto pertext = arena.make<NoiseTexture>(0.1);
+	objects.add(arena.make<Sphere>(Point3(220, 280, 300), 80, arena.make<Lambertian>(pertext)));
+
+	SphereSet boxes2;
+	auto white = arena.make<Lambertian>(Color(.73, .73, .73));
+	int ns = 1000;
+	for (int j = 0; j < ns; j++)
+	{
+		boxes2.add(Vector3::random(0, 165), 10, white);
+	}
+
+	auto instances = arena.make<TLAS>();
+	auto cluster = instances->addBLAS(SphereSet::buildBVH(boxes2, 0.0, 1.0, 8, &arena));
+	instances->addInstance(cluster, Matrix34::translation(Vector3(-100, 270, 395)) * Matrix34::rotationY(15));
+	instances->build(0.0, 1.0);
+	objects.add(instances);
+	
+	return objects;
+}
+
+const char* getSceneName(int id)
+{
+	static const char* names[scene_count] = {
+		"random_scene",
+		"two_spheres",
+		"two_perlin_spheres",
+		"earth",
+		"simple_light",
+		"cornell_box",
+		"cornell_smoke",
+		"final_scene",
+		"cornell_cloud"
+	};
+
+	return names[(id >= 1 && id <= scene_count ? id : 8) - 1];
+}
+
+Scene buildScene(int id, SceneArena& arena)
+{
+	Scene scene;
+
+	switch (id)
+	{
+	case 1:
+		scene.world = random_scene(arena);
+		scene.background = Color(0.70, 0.80, 1.00);
+		scene.lookfrom = Point3(13, 2, 3);
+		scene.lookat = Point3(0, 0, 0);
+		scene.vfov = 20.0;
+		scene.aperture = 0.1;
+		break;
+
+	case 2:
+		scene.world = two_spheres(arena);
+		scene.background = Color(0.70, 0.80, 1.00);
+		scene.lookfrom = Point3(13, 2, 3);
+		scene.lookat = Point3(0, 0, 0);
+		scene.vfov = 20.0;
+		break;
+
+	case 3:
+		scene.world = two_perlin_spheres(arena);
+		scene.background = Color(0.70, 0.80, 1.00);
+		scene.lookfrom = Point3(13, 2, 3);
+		scene.lookat = Point3(0, 0, 0);
+		scene.vfov = 20.0;
+		break;
+
+	case 4:
+		scene.world = earth(arena);
+		scene.background = Color(0.70, 0.80, 1.00);
+		scene.lookfrom = Point3(13, 2, 3);
+		scene.lookat = Point3(0, 0, 0);
+		scene.vfov = 20.0;
+		break;
+
+	case 5:
+		scene.world = simple_light(arena);
+		scene.samples_per_pixel = 400;
+		scene.background = Color(0.0, 0.0, 0.0);
+		scene.lookfrom = Point3(26, 3, 6);
+		scene.lookat = Point3(0, 2, 0);
+		scene.vfov = 20.0;
+		break;
+
+	case 6:
+		scene.world = cornell_box(arena);
+		scene.image_width = 1200;
+		scene.image_height = 1200;
+		scene.samples_per_pixel = 200;
+		scene.background = Color(0, 0, 0);
+		scene.lookfrom = Point3(278, 278, -800);
+		scene.lookat = Point3(278, 278, 0);
+		scene.vfov = 40.0;
+		break;
+
+	case 7:
+		scene.world = cornell_smoke(arena);
+		scene.image_width = 1200;
+		scene.image_height = 1200;
+		scene.samples_per_pixel = 200;
+		scene.background = Color(0, 0, 0);
+		scene.lookfrom = Point3(278, 278, -800);
+		scene.lookat = Point3(278, 278, 0);
+		scene.vfov = 40.0;
+		break;
+
+	case 9:
+		scene.world = cornell_cloud(arena);
+		scene.image_width = 1200;
+		scene.image_height = 1200;
+		scene.samples_per_pixel = 200;
+		scene.background = Color(0, 0, 0);
+		scene.lookfrom = Point3(278, 278, -800);
+		scene.lookat = Point3(278, 278, 0);
+		scene.vfov = 40.0;
+		break;
+
+	default:
+	case 8:
+		scene.world = final_scene(arena);
+		scene.image_width = 1200;
+		scene.image_height = 1200;
+		scene.samples_per_pixel = 10000;
+		scene.background = Color(0, 0, 0);
+		scene.lookfrom = Point3(478, 278, -600);
+		scene.lookat = Point3(278, 278, 0);
+		scene.vfov = 40.0;
+		break;
+	}
+
+	return scene;
+}
+
+Camera Scene::getCamera(double aspect_ratio) const
+{
+	Vector3 vup(0, 1, 0);
+	auto dist_to_focus = 10.0;
+
+	return Camera(lookfrom, lookat, vup, vfov, aspect_ratio, aperture, dist_to_focus, 0.0, 1.0);
+}
@@ -0,0 +1,64 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include <cstdint>
+#include <functional>
+#include <random>
+
+#include "Camera.h"
+#include "Hittable.h"
+#include "SceneArena.h"
+#include "SparseGrid.h"
+
+// A built-in scene: the world plus the camera, background and image
+// settings it was framed for.
+struct Scene
+{
+	HittableList world;
+	Color background = Color(0, 0, 0);
+
+	Point3 lookfrom;
+	Point3 lookat;
+	double vfov = 40.0;
+	double aperture = 0.0;
+
+	int image_width = 1600;
+	int image_height = 900;
+	int samples_per_pixel = 5;
+
+	Camera getCamera(double aspect_ratio) const;
+};
+
+HittableList random_scene(SceneArena& arena);
+HittableList two_spheres(SceneArena& arena);
+HittableList two_perlin_spheres(SceneArena& arena);
+HittableList earth(SceneArena& arena);
+HittableList simple_light(SceneArena& arena);
+HittableList cornell_box(SceneArena& arena);
+HittableList cornell_smoke(SceneArena& arena);
+HittableList final_scene(SceneArena& arena);
+HittableList cornell_cloud(SceneArena& arena);
+
+// Density of cornell_cloud's smoke over bounds, which it sets, evaluated a
+// batch of points at a time. Its noise tables come from the random state, so
+// build it after random_seed() for a repeatable cloud. cloud_voxel_size is
+// the grid spacing the scene samples it at.
+SparseGrid::BatchDensity cloudDensity(AABB& bounds);
+const double cloud_voxel_size = 360.0 / 96;
+
+// Seed the random built-in scenes (random_scene, final_scene and the noise
+// of cornell_cloud) are built with. The renderer and the tools all build
+// from it so they see the same geometry; their --seed options only change
+// the samples.
+const uint32_t scene_seed = std::mt19937::default_seed;
+
+// Built-in scenes are numbered from 1 in the order above, except that
+// final_scene (8) is also the fallback for any unknown id.
+const int scene_count = 9;
+
+const char* getSceneName(int id);
+
+// Builds scene id into arena, which must outlive the returned world.
+Scene buildScene(int id, SceneArena& arena);
+
+#endif // !SCENES_H
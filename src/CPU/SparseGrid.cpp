@@ -0,0 +1,471 @@
+#include "SparseGrid.h"
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+
+#include <tbb/parallel_for.h>
+
+namespace
+{
+	const char sparse_grid_magic[8] = { 'R', 'T', 'V', 'O', 'L', 0, 0, 0 };
+	const uint32_t sparse_grid_version = 1;
+
+	const int leaf_voxels = SparseGrid::leaf_dim * SparseGrid::leaf_dim * SparseGrid::leaf_dim;
+	const int node_leaves = SparseGrid::node_dim * SparseGrid::node_dim * SparseGrid::node_dim;
+
+	inline int popcount64(uint64_t x)
+	{
+#if defined(_MSC_VER)
+		return static_cast<int>(__popcnt64(x));
+#else
+		return __builtin_popcountll(x);
+#endif
+	}
+
+	inline uint64_t align64(uint64_t offset) { return (offset + 63) & ~uint64_t(63); }
+
+	// Last leaf looked up by this thread.
+	struct LeafCache
+	{
+		uint64_t grid = 0;
+		int x = 0, y = 0, z = 0;
+		const float* leaf = nullptr;
+	};
+
+	thread_local LeafCache t_leaf_cache;
+	std::atomic<uint64_t> g_next_grid_id(1);
+}
+
+SparseGrid::SparseGrid(const AABB& bounds, double voxel_size, const BatchDensity& f, float threshold)
+{
+	const Vector3 lo = bounds.getMin();
+	const Vector3 extent = bounds.getMax() - lo;
+
+	int dims[3], leaves[3], root_dims[3];
+	for (int a = 0; a < 3; a++)
+	{
+		dims[a] = max(static_cast<int>(ceil(extent[a] / voxel_size)), 1);
+		leaves[a] = (dims[a] + leaf_dim - 1) / leaf_dim;
+		root_dims[a] = (leaves[a] + node_dim - 1) / node_dim;
+	}
+	const size_t root_count = static_cast<size_t>(root_dims[0]) * root_dims[1] * root_dims[2];
+
+	// Sample every node's leaves in parallel, keeping the active ones.
+	struct NodeBuild
+	{
+		Node node;
+		std::vector<float> voxels;
+		std::vector<float> maxima;
+	};
+	std::vector<NodeBuild> built(root_count);
+
+	tbb::parallel_for(size_t(0), root_count, [&](size_t slot)
+	{
+		NodeBuild& nb = built[slot];
+		memset(&nb.node, 0, sizeof(Node));
+
+		const int nx = static_cast<int>(slot % root_dims[0]);
+		const int ny = static_cast<int>(slot / root_dims[0] % root_dims[1]);
+		const int nz = static_cast<int>(slot / root_dims[0] / root_dims[1]);
+
+		Point3 points[leaf_voxels];
+		double densities[leaf_voxels];
+		float values[leaf_voxels];
+		for (int bit = 0; bit < node_leaves; bit++)
+		{
+			const int lx = nx * node_dim + bit % node_dim;
+			const int ly = ny * node_dim + bit / node_dim % node_dim;
+			const int lz = nz * node_dim + bit / (node_dim * node_dim);
+			if (lx >= leaves[0] || ly >= leaves[1] || lz >= leaves[2])
+				continue;
+
+			// Voxels past the grid's edge read as zero and are not sampled.
+			size_t count = 0;
+			for (int v = 0; v < leaf_voxels; v++)
+			{
+				const int x = lx * leaf_dim + v % leaf_dim;
+				const int y = ly * leaf_dim + v / leaf_dim % leaf_dim;
+				const int z = lz * leaf_dim + v / (leaf_dim * leaf_dim);
+				if (x < dims[0] && y < dims[1] && z < dims[2])
+					points[count++] = lo + voxel_size * Vector3(x + 0.5, y + 0.5, z + 0.5);
+			}
+			f(points, densities, count);
+
+			float leaf_max = 0.0f;
+			bool active = false;
+			size_t sampled = 0;
+			for (int v = 0; v < leaf_voxels; v++)
+			{
+				const int x = lx * leaf_dim + v % leaf_dim;
+				const int y = ly * leaf_dim + v / leaf_dim % leaf_dim;
+				const int z = lz * leaf_dim + v / (leaf_dim * leaf_dim);
+
+				float value = 0.0f;
+				if (x < dims[0] && y < dims[1] && z < dims[2])
+					value = static_cast<float>(densities[sampled++]);
+
+				values[v] = value;
+				leaf_max = max(leaf_max, value);
+				active = active || value > threshold;
+			}
+
+			if (!active)
+				continue;
+
+			nb.node.mask[bit / 64] |= uint64_t(1) << (bit % 64);
+			nb.voxels.insert(nb.voxels.end(), values, values + leaf_voxels);
+			nb.maxima.push_back(leaf_max);
+			nb.node.max_density = max(nb.node.max_density, leaf_max);
+		}
+
+		uint32_t count = 0;
+		for (int w = 0; w < node_leaves / 64; w++)
+		{
+			nb.node.prefix[w] = count;
+			count += popcount64(nb.node.mask[w]);
+		}
+	});
+
+	// Layout
+	uint64_t node_count = 0;
+	uint64_t leaf_count = 0;
+	for (const NodeBuild& nb : built)
+	{
+		if (!nb.maxima.empty())
+		{
+			node_count++;
+			leaf_count += nb.maxima.size();
+		}
+	}
+
+	Header header;
+	memset(&header, 0, sizeof(Header));
+	memcpy(header.magic, sparse_grid_magic, sizeof(header.magic));
+	header.version = sparse_grid_version;
+	for (int a = 0; a < 3; a++)
+	{
+		header.origin[a] = lo[a];
+		header.dims[a] = dims[a];
+		header.root_dims[a] = root_dims[a];
+	}
+	header.voxel_size = voxel_size;
+	header.node_count = node_count;
+	header.leaf_count = leaf_count;
+	header.root_offset = align64(sizeof(Header));
+	header.node_offset = align64(header.root_offset + root_count * sizeof(int32_t));
+	header.leaf_offset = align64(header.node_offset + node_count * sizeof(Node));
+	header.leaf_max_offset = align64(header.leaf_offset + leaf_count * leaf_voxels * sizeof(float));
+	header.file_size = align64(header.leaf_max_offset + leaf_count * sizeof(float));
+
+	m_storage.assign(header.file_size / sizeof(uint64_t), 0);
+	char* data = reinterpret_cast<char*>(m_storage.data());
+	memcpy(data, &header, sizeof(Header));
+
+	int32_t* root = reinterpret_cast<int32_t*>(data + header.root_offset);
+	Node* nodes = reinterpret_cast<Node*>(data + header.node_offset);
+	float* leaf_data = reinterpret_cast<float*>(data + header.leaf_offset);
+	float* leaf_max = reinterpret_cast<float*>(data + header.leaf_max_offset);
+
+	int32_t node_index = 0;
+	uint32_t first_leaf = 0;
+	for (size_t slot = 0; slot < root_count; slot++)
+	{
+		NodeBuild& nb = built[slot];
+		if (nb.maxima.empty())
+		{
+			root[slot] = -1;
+			continue;
+		}
+
+		nb.node.first_leaf = first_leaf;
+		nodes[node_index] = nb.node;
+		memcpy(leaf_data + static_cast<size_t>(first_leaf) * leaf_voxels, nb.voxels.data(), nb.voxels.size() * sizeof(float));
+		memcpy(leaf_max + first_leaf, nb.maxima.data(), nb.maxima.size() * sizeof(float));
+
+		root[slot] = node_index++;
+		first_leaf += static_cast<uint32_t>(nb.maxima.size());
+	}
+
+	attach(data, header.file_size);
+}
+
+shared_ptr<SparseGrid> SparseGrid::load(const char* filename)
+{
+	shared_ptr<SparseGrid> grid(new SparseGrid());
+
+	if (!grid->m_file.open(filename))
+	{
+		std::cerr << "Could not open volume file->" << filename << std::endl;
+		return nullptr;
+	}
+
+	if (!grid->attach(grid->m_file.getData(), grid->m_file.getSize()))
+	{
+		std::cerr << "Invalid volume file->" << filename << std::endl;
+		return nullptr;
+	}
+
+	return grid;
+}
+
+bool SparseGrid::save(const char* filename) const
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+		return false;
+
+	file.write(reinterpret_cast<const char*>(m_header), m_size);
+	return static_cast<bool>(file);
+}
+
+bool SparseGrid::attach(const char* data, size_t size)
+{
+	if (size < sizeof(Header))
+		return false;
+
+	const Header* header = reinterpret_cast<const Header*>(data);
+	if (memcmp(header->magic, sparse_grid_magic, sizeof(header->magic)) != 0 || header->version != sparse_grid_version)
+		return false;
+
+	// Loaded grids are read in place, so everything a lookup follows is
+	// checked here once: the root must match the voxel dimensions, and
+	// sections are bounded by offset first, count second, so no size wraps.
+	if (!(header->voxel_size > 0.0))
+		return false;
+	for (int a = 0; a < 3; a++)
+	{
+		if (header->dims[a] <= 0 || header->root_dims[a] <= 0)
+			return false;
+		const int leaves = (header->dims[a] - 1) / leaf_dim + 1;
+		if (header->root_dims[a] != (leaves - 1) / node_dim + 1)
+			return false;
+	}
+
+	auto fits = [size](uint64_t offset, uint64_t count, uint64_t bytes, uint64_t alignment)
+	{
+		return offset % alignment == 0 && offset <= size && count <= (size - offset) / bytes;
+	};
+
+	const uint64_t root_count = static_cast<uint64_t>(header->root_dims[0]) * header->root_dims[1] * header->root_dims[2];
+	if (header->file_size != size ||
+		!fits(header->root_offset, root_count, sizeof(int32_t), alignof(int32_t)) ||
+		!fits(header->node_offset, header->node_count, sizeof(Node), alignof(Node)) ||
+		!fits(header->leaf_offset, header->leaf_count, leaf_voxels * sizeof(float), alignof(float)) ||
+		!fits(header->leaf_max_offset, header->leaf_count, sizeof(float), alignof(float)))
+		return false;
+
+	const int32_t* root = reinterpret_cast<const int32_t*>(data + header->root_offset);
+	const Node* nodes = reinterpret_cast<const Node*>(data + header->node_offset);
+
+	for (uint64_t slot = 0; slot < root_count; slot++)
+	{
+		if (root[slot] < -1 || (root[slot] >= 0 && static_cast<uint64_t>(root[slot]) >= header->node_count))
+			return false;
+	}
+
+	for (uint64_t n = 0; n < header->node_count; n++)
+	{
+		uint64_t count = 0;
+		for (int w = 0; w < node_leaves / 64; w++)
+		{
+			if (nodes[n].prefix[w] != count)
+				return false;
+			count += popcount64(nodes[n].mask[w]);
+		}
+		if (nodes[n].first_leaf > header->leaf_count || count > header->leaf_count - nodes[n].first_leaf)
+			return false;
+	}
+
+	m_header = header;
+	m_root = root;
+	m_nodes = nodes;
+	m_leaves = reinterpret_cast<const float*>(data + header->leaf_offset);
+	m_leaf_max = reinterpret_cast<const float*>(data + header->leaf_max_offset);
+	m_size = static_cast<size_t>(header->file_size);
+	m_id = g_next_grid_id++;
+	return true;
+}
+
+AABB SparseGrid::getBounds() const
+{
+	const Header& h = *m_header;
+	Vector3 origin(h.origin[0], h.origin[1], h.origin[2]);
+	return AABB(origin, origin + h.voxel_size * Vector3(h.dims[0], h.dims[1], h.dims[2]));
+}
+
+int64_t SparseGrid::findLeaf(const Node& node, int bit)
+{
+	const uint64_t word = node.mask[bit / 64];
+	const uint64_t flag = uint64_t(1) << (bit % 64);
+	if ((word & flag) == 0)
+		return -1;
+
+	return static_cast<int64_t>(node.first_leaf) + node.prefix[bit / 64] + popcount64(word & (flag - 1));
+}
+
+int64_t SparseGrid::findLeaf(int x, int y, int z) const
+{
+	const Header& h = *m_header;
+	if (x < 0 || y < 0 || z < 0)
+		return -1;
+
+	const int nx = x / node_dim;
+	const int ny = y / node_dim;
+	const int nz = z / node_dim;
+	if (nx >= h.root_dims[0] || ny >= h.root_dims[1] || nz >= h.root_dims[2])
+		return -1;
+
+	const int32_t node = m_root[(static_cast<size_t>(nz) * h.root_dims[1] + ny) * h.root_dims[0] + nx];
+	if (node < 0)
+		return -1;
+
+	const int bit = ((z % node_dim) * node_dim + y % node_dim) * node_dim + x % node_dim;
+	return findLeaf(m_nodes[node], bit);
+}
+
+const float* SparseGrid::getLeaf(int x, int y, int z) const
+{
+	LeafCache& cache = t_leaf_cache;
+	if (cache.grid == m_id && cache.x == x && cache.y == y && cache.z == z)
+		return cache.leaf;
+
+	int64_t index = findLeaf(x, y, z);
+	cache.grid = m_id;
+	cache.x = x;
+	cache.y = y;
+	cache.z = z;
+	cache.leaf = index < 0 ? nullptr : m_leaves + index * leaf_voxels;
+	return cache.leaf;
+}
+
+float SparseGrid::voxel(int x, int y, int z) const
+{
+	if (x < 0 || y < 0 || z < 0)
+		return 0.0f;
+
+	const float* leaf = getLeaf(x / leaf_dim, y / leaf_dim, z / leaf_dim);
+	if (leaf == nullptr)
+		return 0.0f;
+
+	return leaf[((z % leaf_dim) * leaf_dim + y % leaf_dim) * leaf_dim + x % leaf_dim];
+}
+
+double SparseGrid::density(const Point3& p) const
+{
+	const Header& h = *m_header;
+	const double inv_voxel = 1.0 / h.voxel_size;
+
+	int i[3];
+	double f[3];
+	for (int a = 0; a < 3; a++)
+	{
+		double x = (p[a] - h.origin[a]) * inv_voxel - 0.5;
+		if (x < -1.0 || x >= h.dims[a])
+			return 0.0;
+
+		double fl = floor(x);
+		i[a] = static_cast<int>(fl);
+		f[a] = x - fl;
+	}
+
+	double c[8];
+	const int mask = leaf_dim - 1;
+	if (i[0] >= 0 && i[1] >= 0 && i[2] >= 0 &&
+		(i[0] & mask) != mask && (i[1] & mask) != mask && (i[2] & mask) != mask)
+	{
+		// All eight corners in one leaf.
+		const float* leaf = getLeaf(i[0] / leaf_dim, i[1] / leaf_dim, i[2] / leaf_dim);
+		if (leaf == nullptr)
+			return 0.0;
+
+		const float* v = leaf + (((i[2] & mask) * leaf_dim + (i[1] & mask)) * leaf_dim + (i[0] & mask));
+		const int dy = leaf_dim;
+		const int dz = leaf_dim * leaf_dim;
+		c[0] = v[0];      c[1] = v[1];
+		c[2] = v[dy];     c[3] = v[dy + 1];
+		c[4] = v[dz];     c[5] = v[dz + 1];
+		c[6] = v[dz + dy]; c[7] = v[dz + dy + 1];
+	}
+	else
+	{
+		for (int k = 0; k < 8; k++)
+			c[k] = voxel(i[0] + (k & 1), i[1] + ((k >> 1) & 1), i[2] + (k >> 2));
+	}
+
+	double c00 = c[0] + f[0] * (c[1] - c[0]);
+	double c10 = c[2] + f[0] * (c[3] - c[2]);
+	double c01 = c[4] + f[0] * (c[5] - c[4]);
+	double c11 = c[6] + f[0] * (c[7] - c[6]);
+	double c0 = c00 + f[1] * (c10 - c00);
+	double c1 = c01 + f[1] * (c11 - c01);
+	return c0 + f[2] * (c1 - c0);
+}
+
+double SparseGrid::getMaxDensity(const AABB& region) const
+{
+	const Header& h = *m_header;
+	const double inv_voxel = 1.0 / h.voxel_size;
+
+	// Leaves holding any voxel whose interpolation support overlaps region.
+	int first[3], last[3];
+	for (int a = 0; a < 3; a++)
+	{
+		int i0 = static_cast<int>(floor((region.getMin()[a] - h.origin[a]) * inv_voxel - 0.5));
+		int i1 = static_cast<int>(floor((region.getMax()[a] - h.origin[a]) * inv_voxel - 0.5)) + 1;
+		i0 = max(i0, 0);
+		i1 = min(i1, h.dims[a] - 1);
+		if (i0 > i1)
+			return 0.0;
+		first[a] = i0 / leaf_dim;
+		last[a] = i1 / leaf_dim;
+	}
+
+	float result = 0.0f;
+	for (int nz = first[2] / node_dim; nz <= last[2] / node_dim; nz++)
+	{
+		for (int ny = first[1] / node_dim; ny <= last[1] / node_dim; ny++)
+		{
+			for (int nx = first[0] / node_dim; nx <= last[0] / node_dim; nx++)
+			{
+				const int32_t index = m_root[(static_cast<size_t>(nz) * h.root_dims[1] + ny) * h.root_dims[0] + nx];
+				if (index < 0)
+					continue;
+				const Node& node = m_nodes[index];
+
+				// Leaf range of this node inside the region.
+				const int n[3] = { nx, ny, nz };
+				int lo[3], hi[3];
+				bool whole = true;
+				for (int a = 0; a < 3; a++)
+				{
+					lo[a] = max(first[a], n[a] * node_dim);
+					hi[a] = min(last[a], n[a] * node_dim + node_dim - 1);
+					whole = whole && lo[a] == n[a] * node_dim && hi[a] == n[a] * node_dim + node_dim - 1;
+				}
+
+				if (whole)
+				{
+					result = max(result, node.max_density);
+					continue;
+				}
+
+				for (int z = lo[2]; z <= hi[2]; z++)
+				{
+					for (int y = lo[1]; y <= hi[1]; y++)
+					{
+						for (int x = lo[0]; x <= hi[0]; x++)
+						{
+							const int bit = ((z % node_dim) * node_dim + y % node_dim) * node_dim + x % node_dim;
+							const int64_t leaf = findLeaf(node, bit);
+							if (leaf >= 0)
+								result = max(result, m_leaf_max[leaf]);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return result;
+}
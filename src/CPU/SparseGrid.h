@@ -0,0 +1,101 @@
+#ifndef SPARSE_GRID_H
+#define SPARSE_GRID_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "MappedFile.h"
+#include "Volume.h"
+
+// Sparse voxel density grid in the spirit of VDB. Voxels live in 8^3 leaf
+// bricks; internal nodes cover 16^3 leaf slots with an active mask, and only
+// active leaves are stored. A dense root array indexes the nodes. Voxels
+// outside active leaves read as zero, so empty space costs neither memory
+// nor majorant.
+//
+// The in-memory layout is the file layout (.rtvol), so load() maps the file
+// and reads it in place. Lookups cache the last leaf per thread, so the
+// consecutive queries of one ray skip the tree descent.
+class SparseGrid : public DensitySource
+{
+public:
+	static const int leaf_dim = 8;
+	static const int node_dim = 16;	// leaves per node side
+
+	// Density at n points: out[i] = f(p[i]).
+	using BatchDensity = std::function<void(const Point3* p, double* out, size_t n)>;
+
+	// Samples f at the voxel centers of a grid with the given voxel size over
+	// bounds, a leaf's voxels per call, keeping only leaves with some value
+	// above threshold.
+	SparseGrid(const AABB& bounds, double voxel_size, const BatchDensity& f, float threshold = 0.0f);
+
+	// Maps an .rtvol file. Returns nullptr and reports to std::cerr on failure.
+	static shared_ptr<SparseGrid> load(const char* filename);
+
+	// Writes the grid as an .rtvol file; Tools/VolumeBaker makes one.
+	bool save(const char* filename) const;
+
+	virtual double density(const Point3& p) const override;
+	virtual AABB getBounds() const override;
+	virtual double getMaxDensity(const AABB& region) const override;
+
+	size_t getLeafCount() const { return static_cast<size_t>(m_header->leaf_count); }
+	size_t getBytes() const { return m_size; }
+
+private:
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t reserved;
+		double origin[3];
+		double voxel_size;
+		int32_t dims[3];		// voxels
+		int32_t root_dims[3];	// nodes
+		uint64_t node_count;
+		uint64_t leaf_count;
+		uint64_t root_offset;	// int32 node index per root slot, -1 if empty
+		uint64_t node_offset;
+		uint64_t leaf_offset;	// leaf_dim^3 floats per leaf, x fastest
+		uint64_t leaf_max_offset;
+		uint64_t file_size;
+	};
+
+	struct Node
+	{
+		uint64_t mask[node_dim * node_dim * node_dim / 64];
+		uint32_t prefix[node_dim * node_dim * node_dim / 64];	// active leaves before each mask word
+		uint32_t first_leaf;
+		float max_density;
+	};
+
+	SparseGrid() = default;
+
+	bool attach(const char* data, size_t size);
+
+	// Index of the leaf at leaf coordinates (x, y, z), -1 if inactive.
+	int64_t findLeaf(int x, int y, int z) const;
+	static int64_t findLeaf(const Node& node, int bit);
+
+	// Voxels of the leaf at leaf coordinates (x, y, z) through the
+	// per-thread cache, nullptr if inactive.
+	const float* getLeaf(int x, int y, int z) const;
+
+	float voxel(int x, int y, int z) const;
+
+private:
+	const Header* m_header = nullptr;
+	const int32_t* m_root = nullptr;
+	const Node* m_nodes = nullptr;
+	const float* m_leaves = nullptr;
+	const float* m_leaf_max = nullptr;
+	size_t m_size = 0;
+	uint64_t m_id = 0;		// identifies this grid in the per-thread cache
+
+	std::vector<uint64_t> m_storage;	// built grids
+	MappedFile m_file;					// loaded grids
+};
+
+#endif // !SPARSE_GRID_H
@@ -0,0 +1,235 @@
+#include "SphereSet.h"
+#include "BVH.h"
+#include "SceneArena.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <numeric>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+uint32_t SphereSet::addMaterial(shared_ptr<Material> m)
+{
+	m_materials->push_back(m);
+	return static_cast<uint32_t>(m_materials->size() - 1);
+}
+
+void SphereSet::add(const Point3& center, double radius, uint32_t material)
+{
+	m_cx.resize(m_size);
+	m_cy.resize(m_size);
+	m_cz.resize(m_size);
+	m_radius.resize(m_size);
+	m_material_ids.resize(m_size);
+
+	m_cx.push_back(center.x);
+	m_cy.push_back(center.y);
+	m_cz.push_back(center.z);
+	m_radius.push_back(radius);
+	m_material_ids.push_back(material);
+
+	AABB box(center - Vector3(radius, radius, radius), center + Vector3(radius, radius, radius));
+	m_box = (m_size == 0) ? box : AABB::surroundingBox(m_box, box);
+	m_size++;
+
+	pad();
+}
+
+void SphereSet::add(const Point3& center, double radius, shared_ptr<Material> m)
+{
+	// Scenes usually add runs of spheres sharing a material, so look from the back.
+	auto& materials = *m_materials;
+	for (size_t i = materials.size(); i-- > 0; )
+	{
+		if (materials[i] == m)
+		{
+			add(center, radius, static_cast<uint32_t>(i));
+			return;
+		}
+	}
+	add(center, radius, addMaterial(m));
+}
+
+void SphereSet::pad()
+{
+	const size_t padded = (m_size + batch_size - 1) / batch_size * batch_size;
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	m_cx.resize(padded, nan);
+	m_cy.resize(padded, nan);
+	m_cz.resize(padded, nan);
+	m_radius.resize(padded, 0.0);
+	m_material_ids.resize(padded, 0);
+}
+
+bool SphereSet::hit(const Ray& r, const double& tmin, const double& tmax, HitRecord& rec) const
+{
+	const Vector3 origin = r.getOrigin();
+	const Vector3 direction = r.getDirection();
+	const double a = direction.getSquaredLength();
+	const size_t count = m_cx.size();
+
+	double closest_so_far = tmax;
+	size_t closest_index = m_size;
+
+#if defined(__AVX2__)
+	const __m256d ox = _mm256_set1_pd(origin.x);
+	const __m256d oy = _mm256_set1_pd(origin.y);
+	const __m256d oz = _mm256_set1_pd(origin.z);
+	const __m256d dx = _mm256_set1_pd(direction.x);
+	const __m256d dy = _mm256_set1_pd(direction.y);
+	const __m256d dz = _mm256_set1_pd(direction.z);
+	const __m256d va = _mm256_set1_pd(a);
+	const __m256d vtmin = _mm256_set1_pd(tmin);
+	const __m256d vinf = _mm256_set1_pd(infinity);
+	const __m256d zero = _mm256_setzero_pd();
+
+	for (size_t i = 0; i < count; i += batch_size)
+	{
+		for (size_t j = i; j < i + batch_size; j += 4)
+		{
+			__m256d ocx = _mm256_sub_pd(ox, _mm256_loadu_pd(&m_cx[j]));
+			__m256d ocy = _mm256_sub_pd(oy, _mm256_loadu_pd(&m_cy[j]));
+			__m256d ocz = _mm256_sub_pd(oz, _mm256_loadu_pd(&m_cz[j]));
+			__m256d radius = _mm256_loadu_pd(&m_radius[j]);
+
+			__m256d half_b = _mm256_add_pd(_mm256_add_pd(
+				_mm256_mul_pd(ocx, dx), _mm256_mul_pd(ocy, dy)), _mm256_mul_pd(ocz, dz));
+			__m256d c = _mm256_sub_pd(_mm256_add_pd(_mm256_add_pd(
+				_mm256_mul_pd(ocx, ocx), _mm256_mul_pd(ocy, ocy)), _mm256_mul_pd(ocz, ocz)),
+				_mm256_mul_pd(radius, radius));
+			__m256d discriminant = _mm256_sub_pd(_mm256_mul_pd(half_b, half_b), _mm256_mul_pd(va, c));
+			__m256d has_roots = _mm256_cmp_pd(discriminant, zero, _CMP_GT_OQ);
+			if (_mm256_movemask_pd(has_roots) == 0)
+				continue;
+
+			__m256d root = _mm256_sqrt_pd(discriminant);
+			__m256d t0 = _mm256_div_pd(_mm256_sub_pd(_mm256_sub_pd(zero, half_b), root), va);
+			__m256d t1 = _mm256_div_pd(_mm256_add_pd(_mm256_sub_pd(zero, half_b), root), va);
+
+			// Near root if it is in range, otherwise the far one (same as Sphere::hit).
+			__m256d vclosest = _mm256_set1_pd(closest_so_far);
+			__m256d ok0 = _mm256_and_pd(_mm256_cmp_pd(t0, vtmin, _CMP_GT_OQ), _mm256_cmp_pd(t0, vclosest, _CMP_LT_OQ));
+			__m256d ok1 = _mm256_and_pd(_mm256_cmp_pd(t1, vtmin, _CMP_GT_OQ), _mm256_cmp_pd(t1, vclosest, _CMP_LT_OQ));
+			__m256d t = _mm256_blendv_pd(_mm256_blendv_pd(vinf, t1, ok1), t0, ok0);
+			t = _mm256_blendv_pd(vinf, t, has_roots);
+
+			int mask = _mm256_movemask_pd(_mm256_cmp_pd(t, vclosest, _CMP_LT_OQ));
+			if (mask == 0)
+				continue;
+
+			alignas(32) double lanes[4];
+			_mm256_store_pd(lanes, t);
+			for (int k = 0; k < 4; k++)
+			{
+				if ((mask & (1 << k)) && lanes[k] < closest_so_far)
+				{
+					closest_so_far = lanes[k];
+					closest_index = j + k;
+				}
+			}
+		}
+	}
+#else
+	for (size_t i = 0; i < m_size; i++)
+	{
+		double ocx = origin.x - m_cx[i];
+		double ocy = origin.y - m_cy[i];
+		double ocz = origin.z - m_cz[i];
+		double half_b = ocx * direction.x + ocy * direction.y + ocz * direction.z;
+		double c = ocx * ocx + ocy * ocy + ocz * ocz - m_radius[i] * m_radius[i];
+		double discriminant = half_b * half_b - a * c;
+		if (discriminant <= 0.0)
+			continue;
+
+		double root = sqrt(discriminant);
+		double t = (-half_b - root) / a;
+		if (t <= tmin || t >= closest_so_far)
+			t = (-half_b + root) / a;
+		if (t > tmin && t < closest_so_far)
+		{
+			closest_so_far = t;
+			closest_index = i;
+		}
+	}
+#endif
+
+	RT_STAT_ADD(PrimitiveTests, m_size);
+
+	if (closest_index == m_size)
+		return false;
+
+	const Point3 center = getCenter(closest_index);
+	const double radius = m_radius[closest_index];
+	rec.t = closest_so_far;
+	rec.position = r.pointAt(rec.t);
+	Vector3 outward_normal = (rec.position - center) / radius;
+	rec.setFaceNormal(r, outward_normal);
+	Sphere::getSphereUV(outward_normal, rec.u, rec.v);
+	rec.uv_density = 1.0 / (pi * radius);
+	rec.mat_ptr = (*m_materials)[m_material_ids[closest_index]];
+	RT_STAT_INC(SphereSetHits);
+
+	return true;
+}
+
+bool SphereSet::boundingBox(const double t0, const double t1, AABB& outputBox) const
+{
+	if (m_size == 0)
+		return false;
+
+	outputBox = m_box;
+	return true;
+}
+
+shared_ptr<Hittable> SphereSet::buildBVH(const SphereSet& spheres, double t0, double t1,
+	size_t leaf_size, SceneArena* arena)
+{
+	if (spheres.m_size == 0)
+		return make_shared<SphereSet>(spheres);
+
+	Stats::ScopedTimer timer(Stats::BVHBuild);
+
+	std::vector<uint32_t> order(spheres.m_size);
+	std::iota(order.begin(), order.end(), 0);
+	return buildNode(spheres, order, 0, order.size(), t0, t1, max(leaf_size, static_cast<size_t>(1)), arena);
+}
+
+shared_ptr<Hittable> SphereSet::buildNode(const SphereSet& spheres, std::vector<uint32_t>& order,
+	size_t start, size_t end, double t0, double t1, size_t leaf_size, SceneArena* arena)
+{
+	if (end - start <= leaf_size)
+	{
+		auto leaf = arena ? arena->make<SphereSet>() : make_shared<SphereSet>();
+		leaf->m_materials = spheres.m_materials;
+		for (size_t i = start; i < end; i++)
+			leaf->add(spheres.getCenter(order[i]), spheres.m_radius[order[i]], spheres.m_material_ids[order[i]]);
+		return leaf;
+	}
+
+	Point3 small = spheres.getCenter(order[start]);
+	Point3 big = small;
+	for (size_t i = start + 1; i < end; i++)
+	{
+		AABB box = AABB::surroundingBox(AABB(small, big), AABB(spheres.getCenter(order[i]), spheres.getCenter(order[i])));
+		small = box.getMin();
+		big = box.getMax();
+	}
+
+	Vector3 extent = big - small;
+	int axis = 0;
+	if (extent.y > extent[axis]) axis = 1;
+	if (extent.z > extent[axis]) axis = 2;
+
+	const std::vector<double>& key = (axis == 0) ? spheres.m_cx : (axis == 1) ? spheres.m_cy : spheres.m_cz;
+	size_t mid = start + (end - start) / 2;
+	std::nth_element(order.begin() + start, order.begin() + mid, order.begin() + end,
+		[&key](uint32_t a, uint32_t b) { return key[a] < key[b]; });
+
+	auto left = buildNode(spheres, order, start, mid, t0, t1, leaf_size, arena);
+	auto right = buildNode(spheres, order, mid, end, t0, t1, leaf_size, arena);
+	if (arena)
+		return arena->make<BVHNode>(left, right, t0, t1);
+	return make_shared<BVHNode>(left, right, t0, t1);
+}
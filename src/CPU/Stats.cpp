@@ -0,0 +1,134 @@
+#include "Stats.h"
+#include "Trace.h"
+
+#include <atomic>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	struct CounterBlock
+	{
+		uint64_t values[Stats::CounterCount] = {};
+	};
+
+	std::mutex g_blocks_mutex;
+	std::vector<std::unique_ptr<CounterBlock>> g_blocks;
+
+	std::atomic<uint64_t> g_phase_nanoseconds[Stats::PhaseCount] = {};
+
+	const char* phase_names[Stats::PhaseCount] = {
+		"scene build", "BVH build", "render", "denoise", "encode/write"
+	};
+}
+
+Stats::TraversalProbe::TraversalProbe()
+{
+#if defined(RT_ENABLE_STATS)
+	const uint64_t* counters = local();
+	m_aabb_tests = counters[BVHNodesVisited];
+	m_primitive_tests = counters[PrimitiveTests];
+	DepthScope::s_max_depth = DepthScope::s_depth;
+#endif
+}
+
+Stats::Traversal Stats::TraversalProbe::read() const
+{
+	Traversal result;
+#if defined(RT_ENABLE_STATS)
+	const uint64_t* counters = local();
+	result.aabb_tests = counters[BVHNodesVisited] - m_aabb_tests;
+	result.primitive_tests = counters[PrimitiveTests] - m_primitive_tests;
+	result.depth = DepthScope::s_max_depth - DepthScope::s_depth;
+#endif
+	return result;
+}
+
+Stats::ScopedTimer::ScopedTimer(Phase phase, bool active)
+	: m_phase(phase), m_active(active), m_start(std::chrono::steady_clock::now())
+{
+}
+
+void Stats::ScopedTimer::stop()
+{
+	if (!m_active)
+		return;
+
+	auto end = std::chrono::steady_clock::now();
+	std::chrono::duration<double> elapsed = end - m_start;
+	addPhaseTime(m_phase, elapsed.count());
+	Trace::addSpan(phase_names[m_phase], "phase", m_start, end);
+	m_active = false;
+}
+
+uint64_t* Stats::registerThread()
+{
+	std::lock_guard<std::mutex> lock(g_blocks_mutex);
+	g_blocks.push_back(std::make_unique<CounterBlock>());
+	return g_blocks.back()->values;
+}
+
+void Stats::merge(uint64_t totals[CounterCount])
+{
+	for (int c = 0; c < CounterCount; c++)
+		totals[c] = 0;
+
+	std::lock_guard<std::mutex> lock(g_blocks_mutex);
+	for (const auto& block : g_blocks)
+		for (int c = 0; c < CounterCount; c++)
+			totals[c] += block->values[c];
+}
+
+void Stats::addPhaseTime(Phase phase, double seconds)
+{
+	g_phase_nanoseconds[phase] += static_cast<uint64_t>(seconds * 1e9);
+}
+
+double Stats::getPhaseTime(Phase phase)
+{
+	return g_phase_nanoseconds[phase] * 1e-9;
+}
+
+void Stats::reset()
+{
+	for (auto& phase : g_phase_nanoseconds)
+		phase = 0;
+
+	std::lock_guard<std::mutex> lock(g_blocks_mutex);
+	for (const auto& block : g_blocks)
+		for (uint64_t& value : block->values)
+			value = 0;
+}
+
+void Stats::print(std::ostream& out)
+{
+	out << "Phases:";
+	for (int p = 0; p < PhaseCount; p++)
+		out << (p == 0 ? " " : ", ") << phase_names[p] << ' ' << std::fixed << std::setprecision(3) << getPhaseTime(static_cast<Phase>(p)) << " s";
+	out << '\n';
+
+#if defined(RT_ENABLE_STATS)
+	uint64_t totals[CounterCount];
+	merge(totals);
+
+	const uint64_t rays = totals[TracedRays];
+	const double render_time = getPhaseTime(Render);
+	const double per_ray = rays > 0 ? 1.0 / rays : 0.0;
+
+	out << "Rays: " << totals[PrimaryRays] << " primary, " << rays - totals[PrimaryRays] << " secondary\n";
+	out << std::setprecision(2)
+		<< "Throughput: " << (render_time > 0.0 ? rays / render_time * 1e-6 : 0.0) << " Mrays/s, "
+		<< "average path length " << (totals[PrimaryRays] > 0 ? double(rays) / totals[PrimaryRays] : 0.0) << '\n';
+	out << "Per ray: " << totals[BVHNodesVisited] * per_ray << " BVH nodes, "
+		<< totals[PrimitiveTests] * per_ray << " primitive tests\n";
+	out << "Hits: " << totals[SphereHits] << " sphere, " << totals[MovingSphereHits] << " moving sphere, "
+		<< totals[RectHits] << " rect, " << totals[BoxHits] << " box, " << totals[TriangleHits] << " triangle, "
+		<< totals[SphereSetHits] << " sphere set, " << totals[MediumHits] << " medium\n";
+#else
+	out << "Ray counters disabled (build with RT_ENABLE_STATS).\n";
+#endif
+
+	out << std::defaultfloat;
+}
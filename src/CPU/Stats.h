@@ -0,0 +1,140 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Renderer instrumentation. Phase timers are always on. Ray and traversal
+// counters exist only when RT_ENABLE_STATS is defined: each thread bumps its
+// own block through the RT_STAT_* macros, and the blocks are merged when the
+// report is printed. Without the define the macros expand to nothing.
+class Stats
+{
+public:
+	enum Counter
+	{
+		PrimaryRays,
+		TracedRays,			// every ray tested against the scene, primary ones included
+		BVHNodesVisited,	// bounding box tests in every acceleration structure
+		PrimitiveTests,
+		SphereHits,
+		MovingSphereHits,
+		RectHits,
+		BoxHits,
+		TriangleHits,
+		SphereSetHits,
+		MediumHits,
+		CounterCount
+	};
+
+	enum Phase
+	{
+		SceneBuild,		// includes BVHBuild
+		BVHBuild,
+		Render,
+		Denoise,
+		Encode,			// conversion, encoding and file writes on the output thread
+		PhaseCount
+	};
+
+	// Adds the time from construction to stop() or destruction to a phase,
+	// and records it as a span when a trace is running.
+	class ScopedTimer
+	{
+	public:
+		explicit ScopedTimer(Phase phase, bool active = true);
+		~ScopedTimer() { stop(); }
+
+		ScopedTimer(const ScopedTimer&) = delete;
+		ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+		void stop();
+
+	private:
+		Phase m_phase;
+		bool m_active;
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+	// Traversal work done by one thread over some interval.
+	struct Traversal
+	{
+		uint64_t aabb_tests = 0;
+		uint64_t primitive_tests = 0;
+		int depth = 0;		// deepest traversal stack reached
+	};
+
+	// Measures the calling thread's traversal work from construction to
+	// read(), for the per-pixel heatmap. Reads zero without RT_ENABLE_STATS.
+	class TraversalProbe
+	{
+	public:
+		TraversalProbe();
+		Traversal read() const;
+
+	private:
+		uint64_t m_aabb_tests = 0;
+		uint64_t m_primitive_tests = 0;
+	};
+
+	// Keeps the traversal depth of the calling thread: recursive traversals
+	// hold a DepthScope per level, stack-based ones report their stack size.
+	class DepthScope
+	{
+	public:
+		DepthScope() { if (++s_depth > s_max_depth) s_max_depth = s_depth; }
+		~DepthScope() { s_depth--; }
+
+		static void reportStack(int size) { if (s_depth + size > s_max_depth) s_max_depth = s_depth + size; }
+
+	private:
+		friend class TraversalProbe;
+
+		static inline thread_local int s_depth = 0;
+		static inline thread_local int s_max_depth = 0;
+	};
+
+#if defined(RT_ENABLE_STATS)
+	static constexpr bool counters_enabled = true;
+#else
+	static constexpr bool counters_enabled = false;
+#endif
+
+	// The calling thread's counter block. Blocks live until exit, so the
+	// counts of finished threads are still merged.
+	static uint64_t* local()
+	{
+		thread_local uint64_t* block = registerThread();
+		return block;
+	}
+
+	// Sums over all threads; call while no rendering is in flight.
+	static void merge(uint64_t totals[CounterCount]);
+
+	static void addPhaseTime(Phase phase, double seconds);
+	static double getPhaseTime(Phase phase);
+
+	static void reset();
+
+	// Phase times, and when counters are compiled in: ray counts, Mrays/s,
+	// average path length, traversal work per ray and hits per primitive.
+	static void print(std::ostream& out);
+
+private:
+	static uint64_t* registerThread();
+};
+
+#if defined(RT_ENABLE_STATS)
+#define RT_STAT_ADD(counter, n) (Stats::local()[Stats::counter] += (n))
+#define RT_STAT_DEPTH_SCOPE() Stats::DepthScope stat_depth_scope
+#define RT_STAT_STACK_DEPTH(size) Stats::DepthScope::reportStack(size)
+#else
+#define RT_STAT_ADD(counter, n) ((void)0)
+#define RT_STAT_DEPTH_SCOPE() ((void)0)
+#define RT_STAT_STACK_DEPTH(size) ((void)0)
+#endif
+
+#define RT_STAT_INC(counter) RT_STAT_ADD(counter, 1)
+
+#endif // !STATS_H
@@ -1,47 +1,160 @@
 #include "Texture.h"
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "External/stb_image.h"
+#include <tbb/parallel_for.h>
 
 ImageTexture::ImageTexture(const char* filename)
+	: m_image(TextureCache::instance().get(filename))
 {
-	m_channel = bytes_per_pixel;
-	auto components_per_pixel = m_channel;
-	m_data = stbi_load(filename, &m_width, &m_height, &components_per_pixel, components_per_pixel);
-	if (m_data == nullptr)
-	{
-		std::cerr << "Failed to load the image->" << filename << std::endl;
-		m_width = m_height = 0;
-	}
 }
 
-ImageTexture::~ImageTexture() 
+Color ImageTexture::value(double u, double v, const Vector3& p) const
 {
-	stbi_image_free(m_data);
+	return value(u, v, p, 0.0);
 }
 
-Color ImageTexture::value(double u, double v, const Vector3& p) const
+Color ImageTexture::value(double u, double v, const Vector3& p, double width) const
 {
 	// If we have no texture data, then return solid cyan as a debugging aid.
-	if (m_data == nullptr)
+	if (m_image == nullptr)
 		return Color(0, 1, 1);
 
 	// Clamp input texture coordinates to [0,1] x [1,0]
 	u = clamp(u, 0.0, 1.0);
 	v = 1.0 - clamp(v, 0.0, 1.0);
 
-	int i = static_cast<int>(u * m_width);
-	int j = static_cast<int>(v * m_height);
+	return m_image->sample(u, v, width);
+}
+
+BakedTexture::BakedTexture(shared_ptr<Texture> source, int width, int height, const SurfaceMap& surface)
+	: m_source(source)
+{
+	width = max(width, 1);
+	height = max(height, 1);
+
+	// Row y holds v = 1 - (y + 0.5) / height to match ImageTexture's flip.
+	std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 3);
+	tbb::parallel_for(tbb::blocked_range<int>(0, height), [&](const tbb::blocked_range<int>& r)
+	{
+		for (int y = r.begin(); y != r.end(); y++)
+		{
+			double v = 1.0 - (y + 0.5) / height;
+			for (int x = 0; x < width; x++)
+			{
+				double u = (x + 0.5) / width;
+				Color c = m_source->value(u, v, surface(u, v));
+
+				unsigned char* pixel = &pixels[(static_cast<size_t>(y) * width + x) * 3];
+				pixel[0] = static_cast<unsigned char>(255.0 * clamp(c.x, 0.0, 1.0) + 0.5);
+				pixel[1] = static_cast<unsigned char>(255.0 * clamp(c.y, 0.0, 1.0) + 0.5);
+				pixel[2] = static_cast<unsigned char>(255.0 * clamp(c.z, 0.0, 1.0) + 0.5);
+			}
+		}
+	});
+
+	m_image = make_shared<const MipMap>(pixels.data(), width, height, 3);
+}
+
+BakedTexture::BakedTexture(shared_ptr<Texture> source, const AABB& bounds, int resolution)
+	: m_source(source), m_bounds(bounds)
+{
+	// Cubic cells sized so the longest axis gets `resolution` cells.
+	Vector3 extent = bounds.getMax() - bounds.getMin();
+	double longest = fmax(extent.x, fmax(extent.y, extent.z));
+	double cell = longest / max(resolution, 1);
+	if (cell <= 0.0)
+		cell = 1.0;
+
+	double inv_cell[3];
+	for (int a = 0; a < 3; a++)
+	{
+		int cells = max(static_cast<int>(ceil(extent[a] / cell)), 1);
+		m_dims[a] = cells + 1;
+		inv_cell[a] = extent[a] > 0.0 ? cells / extent[a] : 0.0;
+	}
+	m_inv_cell = Vector3(inv_cell[0], inv_cell[1], inv_cell[2]);
+
+	const int nx = m_dims[0];
+	const int ny = m_dims[1];
+	const int nz = m_dims[2];
+	m_grid.resize(static_cast<size_t>(nx) * ny * nz * 3);
+
+	tbb::parallel_for(tbb::blocked_range<int>(0, nz), [&](const tbb::blocked_range<int>& r)
+	{
+		for (int z = r.begin(); z != r.end(); z++)
+		{
+			for (int y = 0; y < ny; y++)
+			{
+				for (int x = 0; x < nx; x++)
+				{
+					Point3 p(
+						bounds.getMin().x + (inv_cell[0] > 0.0 ? x / inv_cell[0] : 0.0),
+						bounds.getMin().y + (inv_cell[1] > 0.0 ? y / inv_cell[1] : 0.0),
+						bounds.getMin().z + (inv_cell[2] > 0.0 ? z / inv_cell[2] : 0.0));
+					Color c = m_source->value(0, 0, p);
+
+					float* node = &m_grid[((static_cast<size_t>(z) * ny + y) * nx + x) * 3];
+					node[0] = static_cast<float>(c.x);
+					node[1] = static_cast<float>(c.y);
+					node[2] = static_cast<float>(c.z);
+				}
+			}
+		}
+	});
+}
+
+Color BakedTexture::value(double u, double v, const Vector3& p) const
+{
+	return value(u, v, p, 0.0);
+}
+
+Color BakedTexture::value(double u, double v, const Vector3& p, double width) const
+{
+	if (m_image != nullptr)
+		return m_image->sample(clamp(u, 0.0, 1.0), 1.0 - clamp(v, 0.0, 1.0), width);
+
+	return gridValue(p);
+}
+
+size_t BakedTexture::getBytes() const
+{
+	return m_image != nullptr ? m_image->getBytes() : m_grid.size() * sizeof(float);
+}
+
+Color BakedTexture::gridValue(const Vector3& p) const
+{
+	const Vector3 lo = m_bounds.getMin();
+	const Vector3 hi = m_bounds.getMax();
+	if (p.x < lo.x || p.y < lo.y || p.z < lo.z || p.x > hi.x || p.y > hi.y || p.z > hi.z)
+		return m_source->value(0, 0, p);
+
+	int i[3];
+	double f[3];
+	for (int a = 0; a < 3; a++)
+	{
+		double x = (p[a] - lo[a]) * m_inv_cell[a];
+		i[a] = min(static_cast<int>(x), max(m_dims[a] - 2, 0));
+		f[a] = m_dims[a] > 1 ? x - i[a] : 0.0;
+	}
 
-	// Clamp integer mapping, since actual coordinates should be less than 1.0
-	if (i < 0) i = 0;
-	if (j < 0) j = 0;
-	if (i >= m_width)  i = m_width - 1;
-	if (j >= m_height) j = m_height - 1;
+	const int nx = m_dims[0];
+	const int ny = m_dims[1];
+	const size_t sx = m_dims[0] > 1 ? 3 : 0;
+	const size_t sy = m_dims[1] > 1 ? static_cast<size_t>(nx) * 3 : 0;
+	const size_t sz = m_dims[2] > 1 ? static_cast<size_t>(nx) * ny * 3 : 0;
+	const float* base = &m_grid[((static_cast<size_t>(i[2]) * ny + i[1]) * nx + i[0]) * 3];
 
-	int index = (j * m_width + i) * m_channel;
-	const double color_scale = 1.0 / 255.0;
-	auto pixel = m_data + index;
+	double rgb[3];
+	for (int c = 0; c < 3; c++)
+	{
+		const float* n = base + c;
+		double c00 = n[0] + f[0] * (n[sx] - n[0]);
+		double c10 = n[sy] + f[0] * (n[sy + sx] - n[sy]);
+		double c01 = n[sz] + f[0] * (n[sz + sx] - n[sz]);
+		double c11 = n[sz + sy] + f[0] * (n[sz + sy + sx] - n[sz + sy]);
+		double c0 = c00 + f[1] * (c10 - c00);
+		double c1 = c01 + f[1] * (c11 - c01);
+		rgb[c] = c0 + f[2] * (c1 - c0);
+	}
 
-	return Color(color_scale*pixel[0], color_scale*pixel[1], color_scale*pixel[2]);
-}
\ No newline at end of file
+	return Color(rgb[0], rgb[1], rgb[2]);
+}
@@ -1,13 +1,25 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include <functional>
+#include <vector>
+
+#include "AABB.h"
 #include "Math/Vector3.h"
 #include "Perlin.h"
+#include "TextureCache.h"
 
 class Texture
 {
 public:
 	virtual Color value(double u, double v, const Point3& p) const = 0;
+
+	// Lookup filtered over a footprint of the given width in uv units.
+	// Textures without prefiltered data ignore the width.
+	virtual Color value(double u, double v, const Point3& p, double width) const
+	{
+		return value(u, v, p);
+	}
 };
 
 class SolidColor : public Texture
@@ -69,26 +81,59 @@ public:
 	double m_scale;
 };
 
+// Samples an image from the shared TextureCache, so textures built from the
+// same file share one decoded pyramid. Lookups are bilinear, or trilinear
+// when the caller passes a footprint.
 class ImageTexture : public Texture
 {
 public :
-	const static int bytes_per_pixel = 3;
+	ImageTexture() = default;
+	ImageTexture(const char* filename);
+	ImageTexture(shared_ptr<const MipMap> image) : m_image(image) {}
 
-	// const static int bytes_per_pixel = 3;
-	ImageTexture()
-		: m_data(nullptr), m_width(0), m_height(0), m_channel(0) {}
+	virtual Color value(double u, double v, const Vector3& p) const override;
+	virtual Color value(double u, double v, const Vector3& p, double width) const override;
 
-	ImageTexture(const char* filename);
 
-	~ImageTexture();
+private:
+	shared_ptr<const MipMap> m_image;
+};
+
+// Precomputed copy of a procedural texture, so shading does a table lookup
+// instead of re-evaluating the source at every hit.
+//
+// UV bake: the source is rasterized over the unit square through a surface
+// map (u, v) -> p and stored as a MipMap, which suits textures on a single
+// static parameterized surface. Grid bake: the source is sampled at the
+// nodes of a 3D grid covering bounds and looked up trilinearly; points
+// outside bounds fall back to the source.
+class BakedTexture : public Texture
+{
+public:
+	using SurfaceMap = std::function<Point3(double u, double v)>;
+
+	BakedTexture(shared_ptr<Texture> source, int width, int height, const SurfaceMap& surface);
+	BakedTexture(shared_ptr<Texture> source, const AABB& bounds, int resolution);
 
 	virtual Color value(double u, double v, const Vector3& p) const override;
+	virtual Color value(double u, double v, const Vector3& p, double width) const override;
 
+	size_t getBytes() const;
 
 private:
-	unsigned char *m_data;
-	int m_width, m_height;
-	int m_channel;
+	Color gridValue(const Vector3& p) const;
+
+private:
+	shared_ptr<Texture> m_source;
+
+	// UV bake
+	shared_ptr<const MipMap> m_image;
+
+	// Grid bake
+	AABB m_bounds;
+	int m_dims[3] = { 0, 0, 0 };
+	Vector3 m_inv_cell;
+	std::vector<float> m_grid;	// RGB, x fastest
 };
 
 #endif // !TEXTURE_H
@@ -0,0 +1,101 @@
+#include "TextureCache.h"
+
+#include <filesystem>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "External/stb_image.h"
+
+TextureCache& TextureCache::instance()
+{
+	static TextureCache cache;
+	return cache;
+}
+
+void TextureCache::prefetch(const std::string& filename)
+{
+	lookup(filename, true);
+}
+
+shared_ptr<const MipMap> TextureCache::get(const std::string& filename)
+{
+	return lookup(filename, false).get();
+}
+
+TextureCache::Image TextureCache::lookup(const std::string& filename, bool prefetch)
+{
+	// Different relative spellings of the same file share one entry.
+	std::error_code error;
+	std::string key = std::filesystem::weakly_canonical(filename, error).string();
+	if (error)
+		key = filename;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto found = m_entries.find(key);
+	if (found != m_entries.end())
+	{
+		Entry& entry = found->second;
+		if (!prefetch)
+		{
+			if (entry.prefetched)
+				m_misses++;
+			else
+				m_hits++;
+			entry.prefetched = false;
+		}
+		return entry.image;
+	}
+
+	if (!prefetch)
+		m_misses++;
+	Image image = std::async(std::launch::async, &TextureCache::load, filename).share();
+	m_entries.emplace(key, Entry{ image, prefetch });
+	return image;
+}
+
+shared_ptr<const MipMap> TextureCache::load(const std::string& filename)
+{
+	const int channels = 3;
+	int width, height, components_per_pixel = channels;
+	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &components_per_pixel, channels);
+	if (data == nullptr)
+	{
+		std::cerr << "Failed to load the image->" << filename << std::endl;
+		return nullptr;
+	}
+
+	// The pyramid keeps its own tiled copy, so the decoded rows can go.
+	auto image = make_shared<MipMap>(data, width, height, channels);
+	stbi_image_free(data);
+	return image;
+}
+
+void TextureCache::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.clear();
+}
+
+size_t TextureCache::getBytes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	size_t bytes = 0;
+	for (const auto& entry : m_entries)
+	{
+		const Image& pending = entry.second.image;
+		if (pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			continue;
+		if (auto image = pending.get())
+			bytes += image->getBytes();
+	}
+	return bytes;
+}
+
+void TextureCache::printStats(std::ostream& out) const
+{
+	size_t bytes = getBytes();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	out << "Texture cache: " << m_entries.size() << " images, " << bytes / 1024 << " KiB, "
+		<< m_hits << " hits, " << m_misses << " misses\n";
+}
@@ -0,0 +1,60 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "MipMap.h"
+
+// Process-wide cache of decoded images keyed by canonical file path. Each file
+// is decoded and turned into an immutable MipMap once; prefetch() starts
+// decoding on a background thread so that scenes can kick off all their
+// images up front and have them load in parallel while the rest of the scene
+// is built.
+class TextureCache
+{
+public:
+	static TextureCache& instance();
+
+	void prefetch(const std::string& filename);
+
+	// Blocks until the image is decoded. Returns nullptr if loading failed.
+	shared_ptr<const MipMap> get(const std::string& filename);
+
+	// Drops the cache's references; textures still using an image keep it alive.
+	void clear();
+
+	size_t getHits() const { return m_hits; }
+	size_t getMisses() const { return m_misses; }
+	size_t getBytes() const;
+
+	void printStats(std::ostream& out) const;
+
+private:
+	TextureCache() = default;
+
+	using Image = std::shared_future<shared_ptr<const MipMap>>;
+
+	struct Entry
+	{
+		Image image;
+		bool prefetched;	// not asked for by get() yet
+	};
+
+	// Returns the image for filename, starting a load if there is none yet.
+	// A load started by prefetch() counts as a miss on the first get().
+	Image lookup(const std::string& filename, bool prefetch);
+
+	static shared_ptr<const MipMap> load(const std::string& filename);
+
+private:
+	mutable std::mutex m_mutex;
+	std::unordered_map<std::string, Entry> m_entries;
+	std::atomic<size_t> m_hits{ 0 };
+	std::atomic<size_t> m_misses{ 0 };
+};
+
+#endif // !TEXTURE_CACHE_H
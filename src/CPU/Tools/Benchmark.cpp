@@ -0,0 +1,365 @@
+// Renders the built-in scenes at a fixed resolution, sample count and seed,
+// repeats each run, and reports wall time, Mrays/s, peak RSS and scaling
+// over thread counts (relative to the first count given). The results also
+// go to a JSON file so builds can be compared and regressions caught. On
+// Linux the peak RSS is reset before each scene, so each figure is that
+// scene's own; elsewhere it is the process's peak so far.
+// Scenes are built from scene_seed like in the renderer; --seed only seeds
+// the samples.
+//
+// With --numa the threads of each run are spread over the NUMA nodes, each
+// node rendering against its own copy of the scene, so the scaling across
+// sockets can be compared with a plain run; --pin binds them to cores.
+//
+// Usage: Benchmark [--scenes 1,6,8] [--width 256] [--height 256] [--spp 16]
+//                  [--depth 50] [--seed 1] [--runs 3] [--threads 1,2,4]
+//                  [--numa] [--pin] [--json benchmark.json]
+
+#include "../RenderArenas.h"
+#include "../Renderer.h"
+#include "../Scenes.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <tbb/global_control.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace
+{
+	struct Options
+	{
+		std::vector<int> scenes;
+		std::vector<int> threads;
+		int width = 256;
+		int height = 256;
+		int spp = 16;
+		int depth = 50;
+		uint32_t seed = 1;
+		int runs = 3;
+		bool numa = false;
+		bool pin = false;
+		std::string json = "benchmark.json";
+	};
+
+	struct ThreadRun
+	{
+		int threads;
+		size_t arenas;
+		std::vector<double> seconds;
+		double median;
+		uint64_t rays;
+		uint64_t image_hash;
+	};
+
+	struct SceneResult
+	{
+		int id;
+		double build_seconds;
+		std::vector<ThreadRun> runs;
+		size_t peak_rss;	// this scene's peak if peak_rss_per_scene, else the process's so far
+	};
+
+	bool peak_rss_per_scene = false;
+
+	size_t getPeakRSS()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+		return counters.PeakWorkingSetSize;
+#else
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+#ifdef __APPLE__
+		return static_cast<size_t>(usage.ru_maxrss);
+#else
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+	}
+
+	// Starts a new peak RSS measurement. Linux resets the high-water mark
+	// (VmHWM) through clear_refs; freed heap is handed back first so the
+	// previous scene does not linger in the new figure. Returns false where
+	// the peak can not be reset.
+	bool resetPeakRSS()
+	{
+#if defined(__linux__)
+#ifdef __GLIBC__
+		malloc_trim(0);
+#endif
+		std::ofstream clear_refs("/proc/self/clear_refs");
+		clear_refs << "5";
+		clear_refs.flush();
+		return static_cast<bool>(clear_refs);
+#else
+		return false;
+#endif
+	}
+
+	// Peak RSS since the last successful resetPeakRSS, or of the process.
+	size_t getScenePeakRSS()
+	{
+#if defined(__linux__)
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		while (std::getline(status, line))
+		{
+			if (line.compare(0, 6, "VmHWM:") == 0)
+				return static_cast<size_t>(std::strtoull(line.c_str() + 6, nullptr, 10)) * 1024;
+		}
+#endif
+		return getPeakRSS();
+	}
+
+	// Resetting the high-water mark also resets the process's, so the
+	// process peak is the largest of the scene peaks.
+	size_t getProcessPeakRSS(const std::vector<SceneResult>& results)
+	{
+		size_t peak = getPeakRSS();
+		for (const SceneResult& scene : results)
+			peak = max(peak, scene.peak_rss);
+		return peak;
+	}
+
+	std::vector<int> parseList(const char* text)
+	{
+		std::vector<int> values;
+		std::stringstream stream(text);
+		std::string item;
+		while (std::getline(stream, item, ','))
+			values.push_back(std::atoi(item.c_str()));
+		return values;
+	}
+
+	// FNV-1a over the pixels, to show that runs reproduce the same image.
+	uint64_t hashImage(const Framebuffer& image)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(image.getData());
+		const size_t size = static_cast<size_t>(image.getWidth()) * image.getHeight() * 3 * sizeof(float);
+
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+		return hash;
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int a = 1; a < argc; a++)
+		{
+			const char* arg = argv[a];
+			if (!strcmp(arg, "--numa"))
+			{
+				options.numa = true;
+				continue;
+			}
+			if (!strcmp(arg, "--pin"))
+			{
+				options.pin = true;
+				continue;
+			}
+
+			const char* value = a + 1 < argc ? argv[a + 1] : nullptr;
+			if (!value)
+			{
+				std::cerr << "Missing value->" << arg << std::endl;
+				return false;
+			}
+			a++;
+
+			if (!strcmp(arg, "--scenes")) options.scenes = parseList(value);
+			else if (!strcmp(arg, "--threads")) options.threads = parseList(value);
+			else if (!strcmp(arg, "--width")) options.width = std::atoi(value);
+			else if (!strcmp(arg, "--height")) options.height = std::atoi(value);
+			else if (!strcmp(arg, "--spp")) options.spp = std::atoi(value);
+			else if (!strcmp(arg, "--depth")) options.depth = std::atoi(value);
+			else if (!strcmp(arg, "--seed")) options.seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			else if (!strcmp(arg, "--runs")) options.runs = std::atoi(value);
+			else if (!strcmp(arg, "--json")) options.json = value;
+			else
+			{
+				std::cerr << "Unknown option->" << arg << std::endl;
+				return false;
+			}
+		}
+
+		if (options.scenes.empty())
+		{
+			for (int id = 1; id <= scene_count; id++)
+				options.scenes.push_back(id);
+		}
+
+		for (int id : options.scenes)
+		{
+			if (id < 1 || id > scene_count)
+			{
+				std::cerr << "Scene ids must be 1-" << scene_count << "->" << id << std::endl;
+				return false;
+			}
+		}
+
+		if (options.threads.empty())
+		{
+			// Powers of two up to the hardware, then the hardware itself.
+			const int hardware = max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+			for (int n = 1; n < hardware; n *= 2)
+				options.threads.push_back(n);
+			options.threads.push_back(hardware);
+		}
+
+		options.width = max(options.width, 1);
+		options.height = max(options.height, 1);
+		options.spp = max(options.spp, 1);
+		options.runs = max(options.runs, 1);
+		return true;
+	}
+
+	void writeJSON(std::ostream& out, const Options& options, const std::vector<SceneResult>& results)
+	{
+		out << "{\n  \"settings\": { \"width\": " << options.width << ", \"height\": " << options.height
+			<< ", \"spp\": " << options.spp << ", \"max_depth\": " << options.depth << ", \"seed\": " << options.seed
+			<< ", \"runs\": " << options.runs << ", \"numa\": " << (options.numa ? "true" : "false")
+			<< ", \"pin\": " << (options.pin ? "true" : "false")
+			<< ", \"peak_rss_per_scene\": " << (peak_rss_per_scene ? "true" : "false")
+			<< ", \"hardware_threads\": " << std::thread::hardware_concurrency() << " },\n";
+		out << "  \"scenes\": [\n";
+
+		for (size_t s = 0; s < results.size(); s++)
+		{
+			const SceneResult& scene = results[s];
+			const double base = scene.runs.front().median;	// speedups are relative to the first thread count
+
+			out << "    { \"id\": " << scene.id << ", \"name\": \"" << getSceneName(scene.id) << "\""
+				<< ", \"build_seconds\": " << scene.build_seconds << ", \"peak_rss_bytes\": " << scene.peak_rss
+				<< ", \"runs\": [\n";
+			for (size_t r = 0; r < scene.runs.size(); r++)
+			{
+				const ThreadRun& run = scene.runs[r];
+				out << "      { \"threads\": " << run.threads << ", \"arenas\": " << run.arenas << ", \"seconds\": [";
+				for (size_t i = 0; i < run.seconds.size(); i++)
+					out << (i ? ", " : "") << run.seconds[i];
+				out << "], \"median_seconds\": " << run.median
+					<< ", \"rays\": " << run.rays
+					<< ", \"mrays_per_second\": " << run.rays / run.median * 1e-6
+					<< ", \"speedup\": " << base / run.median
+					<< ", \"image_hash\": \"" << std::hex << run.image_hash << std::dec << "\" }"
+					<< (r + 1 < scene.runs.size() ? ",\n" : "\n");
+			}
+			out << "    ] }" << (s + 1 < results.size() ? ",\n" : "\n");
+		}
+
+		out << "  ],\n  \"peak_rss_bytes\": " << getProcessPeakRSS(results) << "\n}\n";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+		return 1;
+
+	RenderSettings settings;
+	settings.image_width = options.width;
+	settings.image_height = options.height;
+	settings.samples_per_pixel = options.spp;
+	settings.max_depth = options.depth;
+	settings.seed = options.seed;
+	settings.show_progress = false;
+
+	std::vector<SceneResult> results;
+	for (int id : options.scenes)
+	{
+		SceneResult result;
+		result.id = id;
+
+		std::cout << getSceneName(id) << '\n';
+		peak_rss_per_scene = resetPeakRSS();
+
+		Framebuffer image;
+		AOVBuffer aovs;
+		for (int threads : options.threads)
+		{
+			tbb::global_control parallelism(tbb::global_control::max_allowed_parallelism, static_cast<size_t>(max(threads, 1)));
+
+			RenderArenas::Config config;
+			config.threads = max(threads, 1);
+			config.numa = options.numa;
+			config.pin = options.pin;
+			RenderArenas arenas(config);
+
+			// scene_seed gives the same random scenes as the renderer. Only
+			// the first build is reported; with --numa it makes every copy.
+			SceneReplicas replicas;
+			auto build_start = std::chrono::steady_clock::now();
+			replicas.build(arenas, options.numa, scene_seed, [id](SceneArena& arena, Scene& scene)
+			{
+				scene = buildScene(id, arena);
+				return true;
+			});
+			if (result.runs.empty())
+			{
+				result.build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - build_start).count();
+				std::cout << "  build " << result.build_seconds << " s\n";
+			}
+
+			ThreadRun run;
+			run.threads = threads;
+			run.arenas = arenas.getCount();
+			for (int i = 0; i < options.runs; i++)
+			{
+				RenderResult rendered = render(arenas, replicas.getScenes(), settings, image, aovs);
+				run.seconds.push_back(rendered.seconds);
+				run.rays = rendered.rays;
+			}
+			run.image_hash = hashImage(image);
+
+			std::vector<double> sorted = run.seconds;
+			std::sort(sorted.begin(), sorted.end());
+			run.median = sorted[sorted.size() / 2];
+			result.runs.push_back(run);
+
+			std::cout << "  " << threads << " threads in " << run.arenas << " arena(s): " << run.median << " s, "
+				<< run.rays / run.median * 1e-6 << " Mrays/s, speedup "
+				<< result.runs.front().median / run.median << '\n';
+		}
+
+		result.peak_rss = getScenePeakRSS();
+		std::cout << "  peak RSS " << result.peak_rss / (1024 * 1024) << " MiB\n";
+		results.push_back(result);
+	}
+
+	std::ofstream out(options.json);
+	if (!out)
+	{
+		std::cerr << "Could not open benchmark results for writing->" << options.json << std::endl;
+		return 1;
+	}
+	writeJSON(out, options, results);
+
+	std::cout << "Peak RSS " << getProcessPeakRSS(results) / (1024 * 1024) << " MiB, results in " << options.json << '\n';
+	return 0;
+}
@@ -0,0 +1,218 @@
+// Time-to-quality harness. For each scene it renders a high-spp reference
+// once and caches it as a PFM, then renders progressively with the
+// configuration under test and records RMSE and relMSE against the reference
+// after every pass. The output is an error-vs-seconds curve per scene, so
+// sampling and denoising changes are judged by quality reached in a given
+// time rather than by raw spp throughput.
+//
+// Usage: Convergence [--scenes 6,7] [--width 256] [--height 256]
+//                    [--reference-spp 4096] [--reference-dir references]
+//                    [--pass-spp 4] [--time 30] [--seed 1] [--denoise]
+//                    [--sampler random|stratified] [--tile 32]
+//                    [--label default] [--csv convergence.csv]
+
+#include "../Denoiser.h"
+#include "../ImageIO.h"
+#include "../Renderer.h"
+#include "../Scenes.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Options
+	{
+		std::vector<int> scenes = { 6 };
+		int width = 256;
+		int height = 256;
+		int max_depth = 50;
+		int reference_spp = 4096;
+		std::string reference_dir = "references";
+		int pass_spp = 4;
+		double seconds = 30.0;
+		uint32_t seed = 1;
+		bool denoise = false;
+		Sampler sampler = Sampler::Random;
+		int tile_size = 32;
+		std::string label = "default";
+		std::string csv = "convergence.csv";
+	};
+
+	bool parseOptions(int argc, char** argv, Options& options)
+	{
+		for (int a = 1; a < argc; a++)
+		{
+			const char* arg = argv[a];
+			if (!strcmp(arg, "--denoise"))
+			{
+				options.denoise = true;
+				continue;
+			}
+
+			const char* value = a + 1 < argc ? argv[a + 1] : nullptr;
+			if (!value)
+			{
+				std::cerr << "Missing value->" << arg << std::endl;
+				return false;
+			}
+			a++;
+
+			if (!strcmp(arg, "--scenes"))
+			{
+				options.scenes.clear();
+				std::stringstream stream(value);
+				std::string item;
+				while (std::getline(stream, item, ','))
+					options.scenes.push_back(std::atoi(item.c_str()));
+			}
+			else if (!strcmp(arg, "--width")) options.width = max(std::atoi(value), 1);
+			else if (!strcmp(arg, "--height")) options.height = max(std::atoi(value), 1);
+			else if (!strcmp(arg, "--depth")) options.max_depth = std::atoi(value);
+			else if (!strcmp(arg, "--reference-spp")) options.reference_spp = max(std::atoi(value), 1);
+			else if (!strcmp(arg, "--reference-dir")) options.reference_dir = value;
+			else if (!strcmp(arg, "--pass-spp")) options.pass_spp = max(std::atoi(value), 1);
+			else if (!strcmp(arg, "--time")) options.seconds = std::atof(value);
+			else if (!strcmp(arg, "--seed")) options.seed = static_cast<uint32_t>(std::strtoul(value, nullptr, 10));
+			else if (!strcmp(arg, "--tile")) options.tile_size = max(std::atoi(value), 1);
+			else if (!strcmp(arg, "--sampler"))
+			{
+				if (!strcmp(value, "random")) options.sampler = Sampler::Random;
+				else if (!strcmp(value, "stratified")) options.sampler = Sampler::Stratified;
+				else
+				{
+					std::cerr << "Unknown sampler->" << value << std::endl;
+					return false;
+				}
+			}
+			else if (!strcmp(arg, "--label")) options.label = value;
+			else if (!strcmp(arg, "--csv")) options.csv = value;
+			else
+			{
+				std::cerr << "Unknown option->" << arg << std::endl;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Loads the cached reference or renders and caches it. The reference
+	// uses its own seed so it shares no samples with the measured runs.
+	bool getReference(const Scene& scene, int id, const Options& options, Framebuffer& reference)
+	{
+		std::stringstream path;
+		path << options.reference_dir << '/' << getSceneName(id) << '_' << options.width << 'x' << options.height
+			<< '_' << options.reference_spp << "spp_d" << options.max_depth << ".pfm";
+		const std::string filename = path.str();
+
+		if (std::filesystem::exists(filename))
+		{
+			if (readPFM(filename.c_str(), reference) && reference.getWidth() == options.width && reference.getHeight() == options.height)
+				return true;
+			std::cerr << "Rendering the reference again->" << filename << std::endl;
+		}
+
+		RenderSettings settings;
+		settings.image_width = options.width;
+		settings.image_height = options.height;
+		settings.samples_per_pixel = options.reference_spp;
+		settings.max_depth = options.max_depth;
+		settings.seed = ~options.seed;
+
+		std::cout << "Rendering reference " << filename << '\n';
+		AOVBuffer aovs;
+		render(scene, settings, reference, aovs);
+		std::cerr << '\n';
+
+		std::error_code error;
+		std::filesystem::create_directories(options.reference_dir, error);
+		return writePFM(filename.c_str(), reference);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+		return 1;
+
+	std::ofstream csv(options.csv);
+	if (!csv)
+	{
+		std::cerr << "Could not open convergence results for writing->" << options.csv << std::endl;
+		return 1;
+	}
+	const char* sampler = options.sampler == Sampler::Stratified ? "stratified" : "random";
+	csv << "scene,label,sampler,tile,seconds,spp,rmse,relmse\n";
+
+	for (int id : options.scenes)
+	{
+		SceneArena arena;
+		// The cached references are keyed by scene only, so scenes are
+		// always built from scene_seed; --seed varies the samples.
+		random_seed(scene_seed);
+		Scene scene = buildScene(id, arena);
+
+		Framebuffer reference;
+		if (!getReference(scene, id, options, reference))
+			return 1;
+
+		RenderSettings settings;
+		settings.image_width = options.width;
+		settings.image_height = options.height;
+		settings.samples_per_pixel = options.pass_spp;
+		settings.max_depth = options.max_depth;
+		settings.tile_size = options.tile_size;
+		settings.sampler = options.sampler;
+		settings.show_progress = false;
+
+		std::vector<double> sum(static_cast<size_t>(options.width) * options.height * 3, 0.0);
+		Framebuffer pass, average(options.width, options.height);
+		AOVBuffer aovs;
+		double render_seconds = 0.0;
+		double seconds = 0.0;
+
+		std::cout << getSceneName(id) << " (" << options.label << ")\n";
+		for (int p = 0; seconds < options.seconds; p++)
+		{
+			auto start = std::chrono::steady_clock::now();
+
+			// The guides only need a few samples, so the first pass captures them.
+			settings.seed = options.seed + p;
+			settings.capture_aovs = options.denoise && p == 0;
+			render(scene, settings, pass, aovs);
+
+			const float* data = pass.getData();
+			float* out = average.getData();
+			for (size_t i = 0; i < sum.size(); i++)
+			{
+				sum[i] += data[i];
+				out[i] = static_cast<float>(sum[i] / (p + 1));
+			}
+
+			render_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			// A finished render is denoised once, so only this pass's
+			// denoise counts towards the time reported for it.
+			start = std::chrono::steady_clock::now();
+			Framebuffer result = options.denoise ? denoise(average, aovs) : average;
+			seconds = render_seconds + std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			// Measuring stays outside the clock.
+			const int spp = (p + 1) * options.pass_spp;
+			const double rmse = computeRMSE(result, reference);
+			const double relmse = computeRelMSE(result, reference);
+			csv << getSceneName(id) << ',' << options.label << ',' << sampler << ',' << options.tile_size << ',' << seconds << ',' << spp << ',' << rmse << ',' << relmse << '\n';
+			std::cout << "  " << seconds << " s, " << spp << " spp: RMSE " << rmse << ", relMSE " << relmse << '\n';
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,60 @@
+// Compiles a text scene (.rtscene) into its binary form (.rtsb), then loads
+// both and reports how long each took, so the parse cost of large scenes can
+// be checked against the compiled load.
+//
+// Usage: SceneCompiler <input.rtscene> <output.rtsb>
+
+#include "../SceneFile.h"
+#include "../TextureCache.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+namespace
+{
+	// Seconds to load filename into a fresh arena, or a negative value if it
+	// fails. The texture cache is emptied first, so both forms decode their
+	// images and neither reuses the other's.
+	double timeLoad(const char* filename)
+	{
+		TextureCache::instance().clear();
+		SceneArena arena;
+		Scene scene;
+		auto start = std::chrono::steady_clock::now();
+		if (!loadScene(filename, arena, scene))
+			return -1.0;
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc != 3)
+	{
+		std::cerr << "Usage: " << argv[0] << " <input.rtscene> <output.rtsb>" << std::endl;
+		return 1;
+	}
+
+	const char* input = argv[1];
+	const char* output = argv[2];
+
+	auto start = std::chrono::steady_clock::now();
+	if (!compileScene(input, output))
+		return 1;
+	double compile_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::error_code error;
+	std::cout << "Compiled " << input << " (" << std::filesystem::file_size(input, error) << " bytes) to "
+		<< output << " (" << std::filesystem::file_size(output, error) << " bytes) in "
+		<< compile_seconds * 1e3 << " ms\n";
+
+	double text_seconds = timeLoad(input);
+	double compiled_seconds = timeLoad(output);
+	if (text_seconds < 0.0 || compiled_seconds < 0.0)
+		return 1;
+
+	std::cout << "Load, including the scene build: text " << text_seconds * 1e3 << " ms, compiled "
+		<< compiled_seconds * 1e3 << " ms\n";
+	return 0;
+}
@@ -0,0 +1,147 @@
+#include "Trace.h"
+
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+	struct Event
+	{
+		const char* name;
+		const char* category;
+		const char* arg_names[2];
+		int64_t args[2];
+		int64_t start;		// nanoseconds since begin()
+		int64_t duration;
+	};
+
+	// Written only by its thread while recording, read by end().
+	struct ThreadBuffer
+	{
+		int id;
+		std::string name;
+		std::vector<Event> events;
+	};
+
+	std::atomic<bool> g_enabled(false);
+	Trace::Clock::time_point g_origin;
+
+	std::mutex g_buffers_mutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> g_buffers;
+
+	ThreadBuffer& localBuffer()
+	{
+		thread_local ThreadBuffer* buffer = []
+		{
+			std::lock_guard<std::mutex> lock(g_buffers_mutex);
+			g_buffers.push_back(std::make_unique<ThreadBuffer>());
+			g_buffers.back()->id = static_cast<int>(g_buffers.size());
+			g_buffers.back()->events.reserve(1024);
+			return g_buffers.back().get();
+		}();
+		return *buffer;
+	}
+
+	void writeMicroseconds(std::ostream& out, int64_t nanoseconds)
+	{
+		out << nanoseconds / 1000 << '.' << std::setw(3) << std::setfill('0') << nanoseconds % 1000;
+	}
+}
+
+void Trace::begin()
+{
+	{
+		std::lock_guard<std::mutex> lock(g_buffers_mutex);
+		for (const auto& buffer : g_buffers)
+			buffer->events.clear();
+	}
+
+	g_origin = Clock::now();
+	g_enabled.store(true, std::memory_order_release);
+}
+
+bool Trace::isEnabled()
+{
+	return g_enabled.load(std::memory_order_relaxed);
+}
+
+void Trace::setThreadName(const char* name)
+{
+	localBuffer().name = name;
+}
+
+void Trace::addSpan(const char* name, const char* category, Clock::time_point start, Clock::time_point end,
+	const char* arg0_name, int64_t arg0, const char* arg1_name, int64_t arg1)
+{
+	if (!isEnabled())
+		return;
+
+	Event event;
+	event.name = name;
+	event.category = category;
+	event.arg_names[0] = arg0_name;
+	event.arg_names[1] = arg1_name;
+	event.args[0] = arg0;
+	event.args[1] = arg1;
+	event.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start - g_origin).count();
+	event.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	localBuffer().events.push_back(event);
+}
+
+bool Trace::end(const char* filename)
+{
+	g_enabled.store(false, std::memory_order_release);
+
+	std::ofstream out(filename);
+	if (!out)
+	{
+		std::cerr << "Could not open trace for writing->" << filename << std::endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(g_buffers_mutex);
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first = true;
+	for (const auto& buffer : g_buffers)
+	{
+		if (buffer->events.empty())
+			continue;
+
+		out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+			<< ",\"args\":{\"name\":\"" << (buffer->name.empty() ? "thread " + std::to_string(buffer->id) : buffer->name) << "\"}}";
+		first = false;
+
+		for (const Event& event : buffer->events)
+		{
+			out << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category
+				<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id << ",\"ts\":";
+			writeMicroseconds(out, event.start);
+			out << ",\"dur\":";
+			writeMicroseconds(out, event.duration);
+
+			if (event.arg_names[0])
+			{
+				out << ",\"args\":{\"" << event.arg_names[0] << "\":" << event.args[0];
+				if (event.arg_names[1])
+					out << ",\"" << event.arg_names[1] << "\":" << event.args[1];
+				out << '}';
+			}
+			out << '}';
+		}
+	}
+	out << "\n]}\n";
+
+	if (!out)
+	{
+		std::cerr << "Failed writing trace->" << filename << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,69 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <cstdint>
+
+// Timeline recorder that writes the Chrome Trace Event format, which
+// chrome://tracing and Perfetto open directly. Every thread appends spans to
+// its own buffer without locking; the buffers are merged and written as JSON
+// by end(). Recording is off until begin(), and while off a Scope costs one
+// relaxed atomic load.
+//
+// Span names, categories and argument names are not copied, so they must be
+// string literals or otherwise outlive the trace.
+class Trace
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// Starts recording; timestamps are relative to this call.
+	static void begin();
+
+	// Stops recording and writes everything recorded to filename. Call it
+	// once the traced work has finished. Returns false and reports to
+	// std::cerr if the file cannot be written.
+	static bool end(const char* filename);
+
+	static bool isEnabled();
+
+	// Labels the calling thread's track. Unnamed threads show as "thread N".
+	static void setThreadName(const char* name);
+
+	// Records a complete span with up to two integer arguments.
+	static void addSpan(const char* name, const char* category, Clock::time_point start, Clock::time_point end,
+		const char* arg0_name = nullptr, int64_t arg0 = 0, const char* arg1_name = nullptr, int64_t arg1 = 0);
+
+	// Records the span from construction to destruction.
+	class Scope
+	{
+	public:
+		Scope(const char* name, const char* category,
+			const char* arg0_name = nullptr, int64_t arg0 = 0, const char* arg1_name = nullptr, int64_t arg1 = 0)
+			: m_name(name), m_category(category), m_arg0_name(arg0_name), m_arg1_name(arg1_name), m_arg0(arg0), m_arg1(arg1)
+		{
+			if (isEnabled())
+				m_start = Clock::now();
+		}
+
+		~Scope()
+		{
+			if (m_start != Clock::time_point())
+				addSpan(m_name, m_category, m_start, Clock::now(), m_arg0_name, m_arg0, m_arg1_name, m_arg1);
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		const char* m_name;
+		const char* m_category;
+		const char* m_arg0_name;
+		const char* m_arg1_name;
+		int64_t m_arg0;
+		int64_t m_arg1;
+		Clock::time_point m_start;
+	};
+};
+
+#endif // !TRACE_H
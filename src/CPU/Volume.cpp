@@ -0,0 +1,132 @@
+#include "Volume.h"
+
+#include <tbb/parallel_for.h>
+
+DenseGrid::DenseGrid(const AABB& bounds, int nx, int ny, int nz, std::vector<float> voxels)
+	: m_bounds(bounds), m_voxels(std::move(voxels))
+{
+	m_dims[0] = max(nx, 1);
+	m_dims[1] = max(ny, 1);
+	m_dims[2] = max(nz, 1);
+	m_voxels.resize(static_cast<size_t>(m_dims[0]) * m_dims[1] * m_dims[2], 0.0f);
+
+	Vector3 extent = bounds.getMax() - bounds.getMin();
+	for (int a = 0; a < 3; a++)
+		m_inv_voxel[a] = extent[a] > 0.0 ? m_dims[a] / extent[a] : 0.0;
+}
+
+DenseGrid::DenseGrid(const AABB& bounds, int nx, int ny, int nz, const std::function<double(const Point3&)>& f)
+	: DenseGrid(bounds, nx, ny, nz, std::vector<float>())
+{
+	const Vector3 lo = bounds.getMin();
+	const Vector3 size = bounds.getMax() - lo;
+
+	tbb::parallel_for(tbb::blocked_range<int>(0, m_dims[2]), [&](const tbb::blocked_range<int>& r)
+	{
+		for (int z = r.begin(); z != r.end(); z++)
+		{
+			for (int y = 0; y < m_dims[1]; y++)
+			{
+				for (int x = 0; x < m_dims[0]; x++)
+				{
+					Point3 p(
+						lo.x + size.x * (x + 0.5) / m_dims[0],
+						lo.y + size.y * (y + 0.5) / m_dims[1],
+						lo.z + size.z * (z + 0.5) / m_dims[2]);
+					m_voxels[(static_cast<size_t>(z) * m_dims[1] + y) * m_dims[0] + x] = static_cast<float>(f(p));
+				}
+			}
+		}
+	});
+}
+
+double DenseGrid::density(const Point3& p) const
+{
+	const Vector3 lo = m_bounds.getMin();
+	const Vector3 hi = m_bounds.getMax();
+	if (p.x < lo.x || p.y < lo.y || p.z < lo.z || p.x > hi.x || p.y > hi.y || p.z > hi.z)
+		return 0.0;
+
+	// Voxel-centered coordinates, clamped at the faces.
+	int i0[3], i1[3];
+	double f[3];
+	for (int a = 0; a < 3; a++)
+	{
+		double x = (p[a] - lo[a]) * m_inv_voxel[a] - 0.5;
+		double fl = floor(x);
+		int i = static_cast<int>(fl);
+		f[a] = x - fl;
+		i0[a] = i < 0 ? 0 : (i >= m_dims[a] ? m_dims[a] - 1 : i);
+		i1[a] = i + 1 < 0 ? 0 : (i + 1 >= m_dims[a] ? m_dims[a] - 1 : i + 1);
+	}
+
+	double c00 = voxel(i0[0], i0[1], i0[2]) + f[0] * (voxel(i1[0], i0[1], i0[2]) - voxel(i0[0], i0[1], i0[2]));
+	double c10 = voxel(i0[0], i1[1], i0[2]) + f[0] * (voxel(i1[0], i1[1], i0[2]) - voxel(i0[0], i1[1], i0[2]));
+	double c01 = voxel(i0[0], i0[1], i1[2]) + f[0] * (voxel(i1[0], i0[1], i1[2]) - voxel(i0[0], i0[1], i1[2]));
+	double c11 = voxel(i0[0], i1[1], i1[2]) + f[0] * (voxel(i1[0], i1[1], i1[2]) - voxel(i0[0], i1[1], i1[2]));
+	double c0 = c00 + f[1] * (c10 - c00);
+	double c1 = c01 + f[1] * (c11 - c01);
+	return c0 + f[2] * (c1 - c0);
+}
+
+double DenseGrid::getMaxDensity(const AABB& region) const
+{
+	// Every voxel whose interpolation support overlaps the region.
+	const Vector3 lo = m_bounds.getMin();
+	int first[3], last[3];
+	for (int a = 0; a < 3; a++)
+	{
+		int i0 = static_cast<int>(floor((region.getMin()[a] - lo[a]) * m_inv_voxel[a] - 0.5));
+		int i1 = static_cast<int>(floor((region.getMax()[a] - lo[a]) * m_inv_voxel[a] - 0.5)) + 1;
+		first[a] = max(i0, 0);
+		last[a] = min(i1, m_dims[a] - 1);
+		if (first[a] > last[a])
+			return 0.0;
+	}
+
+	float result = 0.0f;
+	for (int z = first[2]; z <= last[2]; z++)
+		for (int y = first[1]; y <= last[1]; y++)
+			for (int x = first[0]; x <= last[0]; x++)
+				result = max(result, voxel(x, y, z));
+	return result;
+}
+
+MajorantGrid::MajorantGrid(const DensitySource& source, int resolution)
+	: m_bounds(source.getBounds())
+{
+	Vector3 extent = m_bounds.getMax() - m_bounds.getMin();
+	double longest = fmax(extent.x, fmax(extent.y, extent.z));
+	if (longest <= 0.0)
+		return;
+
+	double cell = longest / max(resolution, 1);
+	for (int a = 0; a < 3; a++)
+	{
+		m_dims[a] = max(static_cast<int>(ceil(extent[a] / cell)), 1);
+		m_cell[a] = extent[a] > 0.0 ? extent[a] / m_dims[a] : cell;
+	}
+
+	m_majorants.resize(static_cast<size_t>(m_dims[0]) * m_dims[1] * m_dims[2]);
+	const Vector3 lo = m_bounds.getMin();
+
+	tbb::parallel_for(tbb::blocked_range<int>(0, m_dims[2]), [&](const tbb::blocked_range<int>& r)
+	{
+		for (int z = r.begin(); z != r.end(); z++)
+		{
+			for (int y = 0; y < m_dims[1]; y++)
+			{
+				for (int x = 0; x < m_dims[0]; x++)
+				{
+					Vector3 cell_min(lo.x + x * m_cell[0], lo.y + y * m_cell[1], lo.z + z * m_cell[2]);
+					Vector3 cell_max = cell_min + Vector3(m_cell[0], m_cell[1], m_cell[2]);
+					m_majorants[(static_cast<size_t>(z) * m_dims[1] + y) * m_dims[0] + x] =
+						static_cast<float>(source.getMaxDensity(AABB(cell_min, cell_max)));
+				}
+			}
+		}
+	});
+
+	for (float m : m_majorants)
+		m_max_density = fmax(m_max_density, m);
+}
@@ -0,0 +1,160 @@
+#ifndef VOLUME_H
+#define VOLUME_H
+
+#include <functional>
+#include <vector>
+
+#include "AABB.h"
+
+// Scalar density field sampled by heterogeneous media.
+class DensitySource
+{
+public:
+	virtual ~DensitySource() = default;
+
+	// Density at p, 0 outside getBounds().
+	virtual double density(const Point3& p) const = 0;
+
+	virtual AABB getBounds() const = 0;
+
+	// Upper bound of density() over region, used to build majorants. It may
+	// be loose but must never be below the true maximum.
+	virtual double getMaxDensity(const AABB& region) const = 0;
+};
+
+// Dense voxel grid over an axis-aligned box. Values sit at voxel centers and
+// are interpolated trilinearly.
+class DenseGrid : public DensitySource
+{
+public:
+	DenseGrid(const AABB& bounds, int nx, int ny, int nz, std::vector<float> voxels);
+
+	// Fills the grid by evaluating f at every voxel center.
+	DenseGrid(const AABB& bounds, int nx, int ny, int nz, const std::function<double(const Point3&)>& f);
+
+	virtual double density(const Point3& p) const override;
+	virtual AABB getBounds() const override { return m_bounds; }
+	virtual double getMaxDensity(const AABB& region) const override;
+
+	size_t getBytes() const { return m_voxels.size() * sizeof(float); }
+
+private:
+	float voxel(int x, int y, int z) const
+	{
+		return m_voxels[(static_cast<size_t>(z) * m_dims[1] + y) * m_dims[0] + x];
+	}
+
+private:
+	AABB m_bounds;
+	int m_dims[3];
+	double m_inv_voxel[3];	// voxels per world unit
+	std::vector<float> m_voxels;	// x fastest
+};
+
+// Coarse grid of per-cell density maxima over a DensitySource. Free-flight
+// sampling steps through it cell by cell, so each segment is tracked against
+// a tight local majorant and empty cells are skipped outright.
+class MajorantGrid
+{
+public:
+	MajorantGrid() = default;
+
+	// resolution is the cell count along the longest axis of the bounds.
+	MajorantGrid(const DensitySource& source, int resolution = 16);
+
+	const AABB& getBounds() const { return m_bounds; }
+	double getMaxDensity() const { return m_max_density; }
+
+	// Calls visit(t0, t1, majorant) for each cell the ray crosses inside
+	// [tmin, tmax], front to back, until visit returns true. Returns whether
+	// some visit did.
+	template<typename Visitor>
+	bool traverse(const Ray& r, double tmin, double tmax, Visitor&& visit) const;
+
+private:
+	AABB m_bounds;
+	int m_dims[3] = { 0, 0, 0 };
+	double m_cell[3] = { 0, 0, 0 };
+	double m_max_density = 0.0;
+	std::vector<float> m_majorants;
+};
+
+template<typename Visitor>
+bool MajorantGrid::traverse(const Ray& r, double tmin, double tmax, Visitor&& visit) const
+{
+	if (m_majorants.empty())
+		return false;
+
+	const Vector3 origin = r.getOrigin();
+	const Vector3 direction = r.getDirection();
+	const Vector3 lo = m_bounds.getMin();
+
+	// Clip to the grid.
+	for (int a = 0; a < 3; a++)
+	{
+		double inv_d = 1.0 / direction[a];
+		double t0 = (lo[a] - origin[a]) * inv_d;
+		double t1 = (m_bounds.getMax()[a] - origin[a]) * inv_d;
+		if (inv_d < 0.0)
+			std::swap(t0, t1);
+		tmin = fmax(tmin, t0);
+		tmax = fmin(tmax, t1);
+	}
+	if (tmin >= tmax)
+		return false;
+
+	// 3D DDA setup
+	const Point3 start = r.pointAt(tmin);
+	int cell[3];
+	int step[3];
+	double next_t[3];
+	double delta_t[3];
+	for (int a = 0; a < 3; a++)
+	{
+		cell[a] = static_cast<int>((start[a] - lo[a]) / m_cell[a]);
+		cell[a] = cell[a] < 0 ? 0 : (cell[a] >= m_dims[a] ? m_dims[a] - 1 : cell[a]);
+
+		if (direction[a] > 0.0)
+		{
+			step[a] = 1;
+			next_t[a] = tmin + (lo[a] + (cell[a] + 1) * m_cell[a] - start[a]) / direction[a];
+			delta_t[a] = m_cell[a] / direction[a];
+		}
+		else if (direction[a] < 0.0)
+		{
+			step[a] = -1;
+			next_t[a] = tmin + (lo[a] + cell[a] * m_cell[a] - start[a]) / direction[a];
+			delta_t[a] = -m_cell[a] / direction[a];
+		}
+		else
+		{
+			step[a] = 0;
+			next_t[a] = infinity;
+			delta_t[a] = infinity;
+		}
+	}
+
+	double t = tmin;
+	while (true)
+	{
+		int axis = next_t[0] < next_t[1]
+			? (next_t[0] < next_t[2] ? 0 : 2)
+			: (next_t[1] < next_t[2] ? 1 : 2);
+		double t_end = fmin(next_t[axis], tmax);
+
+		double majorant = m_majorants[(static_cast<size_t>(cell[2]) * m_dims[1] + cell[1]) * m_dims[0] + cell[0]];
+		if (t_end > t && visit(t, t_end, majorant))
+			return true;
+
+		if (t_end >= tmax)
+			return false;
+
+		t = t_end;
+		cell[axis] += step[axis];
+		if (cell[axis] < 0 || cell[axis] >= m_dims[axis])
+			return false;
+		next_t[axis] += delta_t[axis];
+	}
+}
+
+#endif // !VOLUME_H